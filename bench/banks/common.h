@@ -0,0 +1,31 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Size in bytes of one token, and the number of tokens per core
+#define TOKEN_SIZE 2048
+#define TOKENS 64
+
+// Number of times the computation reads every token
+#define PASSES 4
+
+// Tags of the results that the cores send up
+enum { RESULT_SAME_BANK, RESULT_OTHER_BANK, RESULT_STREAM, RESULTS };
@@ -0,0 +1,100 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "common.h"
+
+#define TOKEN_INTS (TOKEN_SIZE / sizeof(int))
+
+volatile int checksum = 0;
+
+// The work on every token, which reads the whole token a few times
+void compute(const int* token) {
+    int sum = 0;
+    for (int pass = 0; pass < PASSES; pass++)
+        for (int i = 0; i < TOKEN_INTS; i++)
+            sum += token[i];
+    checksum += sum;
+}
+
+// Reads the tokens from external memory with double buffering: the DMA
+// engine fills one buffer while the CPU computes on the other
+unsigned int double_buffer(const int* src, int* buf0, int* buf1) {
+    ebsp_dma_handle desc;
+    ebsp_raw_time();
+    ebsp_dma_push(&desc, buf0, src, TOKEN_SIZE);
+    for (int t = 0; t < TOKENS; t++) {
+        ebsp_dma_wait(&desc);
+        int* current = (t % 2 == 0) ? buf0 : buf1;
+        int* next = (t % 2 == 0) ? buf1 : buf0;
+        if (t + 1 < TOKENS)
+            ebsp_dma_push(&desc, next, src + (t + 1) * TOKEN_INTS,
+                          TOKEN_SIZE);
+        compute(current);
+    }
+    return ebsp_raw_time();
+}
+
+void send_result(int tag, unsigned int cycles) {
+    ebsp_send_up(&tag, &cycles, sizeof(unsigned int));
+}
+
+int main() {
+    bsp_begin();
+
+    int* src = ebsp_ext_malloc(TOKENS * TOKEN_SIZE);
+    if (src == 0) {
+        ebsp_message("Could not allocate external memory");
+        bsp_end();
+        return 0;
+    }
+    for (int i = 0; i < TOKENS * TOKEN_INTS; i++)
+        src[i] = i;
+
+    // Both buffers in the same bank, so the DMA engine and the CPU
+    // access the same bank
+    int* buf0 = ebsp_malloc_bank(TOKEN_SIZE, 2);
+    int* buf1 = ebsp_malloc_bank(TOKEN_SIZE, 2);
+    double_buffer(src, buf0, buf1); // warm up
+    send_result(RESULT_SAME_BANK, double_buffer(src, buf0, buf1));
+    ebsp_free(buf1);
+
+    // The buffers in different banks
+    buf1 = ebsp_malloc_bank(TOKEN_SIZE, 3);
+    send_result(RESULT_OTHER_BANK, double_buffer(src, buf0, buf1));
+    ebsp_free(buf0);
+    ebsp_free(buf1);
+    ebsp_free(src);
+
+    // A stream with preloading, which puts its buffers in different banks
+    ebsp_stream stream;
+    bsp_stream_open(&stream, bsp_pid());
+    void* token = 0;
+    ebsp_raw_time();
+    while (bsp_stream_move_down(&stream, &token, 1))
+        compute(token);
+    send_result(RESULT_STREAM, ebsp_raw_time());
+    bsp_stream_close(&stream);
+
+    bsp_end();
+    return 0;
+}
@@ -0,0 +1,76 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Measures the time of double buffered reads from external memory when the
+// two local buffers are in the same memory bank and when they are in
+// different banks, and the time of a down stream with preloading.
+//
+// Usage: host_banks [nprocs]
+
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+
+const char* names[RESULTS] = {"same bank", "other bank", "stream"};
+
+int main(int argc, char** argv) {
+    bsp_init("e_banks.elf", argc, argv);
+    int nprocs = (argc > 1) ? atoi(argv[1]) : bsp_nprocs();
+    bsp_begin(nprocs);
+
+    int* data = malloc(TOKENS * TOKEN_SIZE);
+    for (int i = 0; i < TOKENS * TOKEN_SIZE / (int)sizeof(int); i++)
+        data[i] = i;
+    for (int pid = 0; pid < nprocs; pid++)
+        bsp_stream_create(TOKENS * TOKEN_SIZE, TOKEN_SIZE, data);
+    free(data);
+
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+    ebsp_spmd();
+
+    // Average of the cores
+    double cycles[RESULTS] = {0};
+    int packets, accum_bytes;
+    ebsp_qsize(&packets, &accum_bytes);
+    for (int i = 0; i < packets; i++) {
+        int tag, status;
+        unsigned int value;
+        ebsp_get_tag(&status, &tag);
+        ebsp_move(&value, sizeof(unsigned int));
+        if (tag >= 0 && tag < RESULTS)
+            cycles[tag] += (double)value / nprocs;
+    }
+
+    bsp_end();
+
+    // The cores run at 600 MHz
+    printf("%-12s %16s %12s\n", "buffers", "cycles/token", "MB/s");
+    for (int i = 0; i < RESULTS; i++) {
+        double per_token = cycles[i] / TOKENS;
+        printf("%-12s %16.0f %12.1f\n", names[i], per_token,
+               TOKEN_SIZE * 600.0 / per_token);
+    }
+
+    return 0;
+}
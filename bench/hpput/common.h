@@ -0,0 +1,32 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Number of calls that are timed
+#define CALLS 1000
+
+// Number of registered variables that the calls cycle through to miss the
+// cache of recently used variables
+#define VARS 8
+
+// Tags of the results that the cores send up
+enum { RESULT_HPPUT_HIT, RESULT_HPPUT_MISS, RESULT_HPGET_HIT,
+       RESULT_HPGET_MISS, RESULTS };
@@ -0,0 +1,68 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "common.h"
+
+int targets[VARS];
+
+void send_result(int tag, unsigned int cycles) {
+    ebsp_send_up(&tag, &cycles, sizeof(unsigned int));
+}
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int dst = (p + 1) % bsp_nprocs();
+    for (int v = 0; v < VARS; v++) {
+        bsp_push_reg(&targets[v], sizeof(int));
+        bsp_sync();
+    }
+
+    // The same variable every time, so its remote address is cached
+    ebsp_raw_time();
+    for (int i = 0; i < CALLS; i++)
+        bsp_hpput(dst, &i, &targets[0], 0, sizeof(int));
+    send_result(RESULT_HPPUT_HIT, ebsp_raw_time());
+
+    // A different variable every time, so the remote address is read
+    // from the other core for every call
+    ebsp_raw_time();
+    for (int i = 0; i < CALLS; i++)
+        bsp_hpput(dst, &i, &targets[i % VARS], 0, sizeof(int));
+    send_result(RESULT_HPPUT_MISS, ebsp_raw_time());
+
+    int value = 0;
+    ebsp_raw_time();
+    for (int i = 0; i < CALLS; i++)
+        bsp_hpget(dst, &targets[0], 0, &value, sizeof(int));
+    send_result(RESULT_HPGET_HIT, ebsp_raw_time());
+
+    ebsp_raw_time();
+    for (int i = 0; i < CALLS; i++)
+        bsp_hpget(dst, &targets[i % VARS], 0, &value, sizeof(int));
+    send_result(RESULT_HPGET_MISS, ebsp_raw_time());
+
+    bsp_end();
+    return 0;
+}
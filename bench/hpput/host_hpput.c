@@ -0,0 +1,66 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Measures the cost of bsp_hpput and bsp_hpget when the remote address of
+// the variable is in the cache of recently used variables, and when it is
+// read from the other core for every call.
+//
+// Usage: host_hpput [nprocs]
+
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+
+const char* names[RESULTS] = {"hpput cached", "hpput miss", "hpget cached",
+                              "hpget miss"};
+
+int main(int argc, char** argv) {
+    bsp_init("e_hpput.elf", argc, argv);
+    int nprocs = (argc > 1) ? atoi(argv[1]) : bsp_nprocs();
+    bsp_begin(nprocs);
+
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+    ebsp_spmd();
+
+    // Average of the cores
+    double cycles[RESULTS] = {0};
+    int packets, accum_bytes;
+    ebsp_qsize(&packets, &accum_bytes);
+    for (int i = 0; i < packets; i++) {
+        int tag, status;
+        unsigned int value;
+        ebsp_get_tag(&status, &tag);
+        ebsp_move(&value, sizeof(unsigned int));
+        if (tag >= 0 && tag < RESULTS)
+            cycles[tag] += (double)value / nprocs;
+    }
+
+    bsp_end();
+
+    printf("%-14s %12s\n", "call", "cycles/call");
+    for (int i = 0; i < RESULTS; i++)
+        printf("%-14s %12.1f\n", names[i], cycles[i] / CALLS);
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+// The allocators of src/extmem_malloc_implementation.cpp,
+// compiled with and without MALLOC_SIZE_CLASSES
+typedef struct {
+    const char* name;
+    void* (*malloc)(void* base, uint32_t nbytes);
+    void (*free)(void* base, void* ptr);
+    void (*init)(void* base, uint32_t size);
+    void (*info)(void* base, uint32_t* used, uint32_t* free,
+                 uint32_t* free_list);
+} allocator;
+
+extern allocator bitmap_allocator;
+extern allocator size_class_allocator;
+
+// Size of the heap, roughly that of ebsp_ext_malloc
+#define HEAP_SIZE (8 << 20)
+
+// Number of allocations of every workload
+#define OPERATIONS 200000
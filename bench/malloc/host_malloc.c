@@ -0,0 +1,215 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Compares the allocation throughput and the fragmentation of the heap of
+// ebsp_ext_malloc and ebsp_malloc with and without MALLOC_SIZE_CLASSES.
+// This runs on the host only, the allocators are the same on the cores.
+//
+// Workloads:
+// - stream: the host creates streams, every stream is a large buffer with
+//   a small descriptor, and the oldest stream is destroyed first
+// - put: many small buffers of random size with random lifetimes, like the
+//   temporary buffers of a program that sends many small messages
+// - large: large streams are created in a heap that is mostly filled by
+//   other streams, with a few holes that are too small
+//
+// For every workload this prints the allocations per second, the highest
+// address in use relative to the start of the heap, the largest block
+// that can still be allocated afterwards, the free memory and the free
+// memory that is kept in the lists of MALLOC_SIZE_CLASSES
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "common.h"
+
+// Number of buffers that are alive at the same time
+#define STREAM_SLOTS 16
+#define PUT_SLOTS 4096
+
+// Size of the streams that fill the heap in the large workload
+#define STREAM_SIZE (64 * 1024)
+#define LARGE_OPERATIONS 20000
+
+typedef struct {
+    void* ptr;
+    uint32_t size;
+} slot;
+
+typedef struct {
+    const char* name;
+    // Returns the number of allocations
+    int (*run)(allocator* a, void* heap, uint32_t* peak);
+} workload;
+
+uint32_t random_state = 1;
+
+uint32_t next_random() {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+double seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+void track_peak(void* heap, void* ptr, uint32_t size, uint32_t* peak) {
+    uint32_t end = (uint32_t)((char*)ptr + size - (char*)heap);
+    if (end > *peak)
+        *peak = end;
+}
+
+int run_stream(allocator* a, void* heap, uint32_t* peak) {
+    slot buffers[STREAM_SLOTS] = {{0}};
+    slot descriptors[STREAM_SLOTS] = {{0}};
+    for (int i = 0; i < OPERATIONS / 2; i++) {
+        int k = i % STREAM_SLOTS;
+        if (buffers[k].ptr) {
+            a->free(heap, buffers[k].ptr);
+            a->free(heap, descriptors[k].ptr);
+        }
+        buffers[k].size = 1024 + (next_random() % 64) * 1024;
+        descriptors[k].size = 16 + (next_random() % 4) * 8;
+        buffers[k].ptr = a->malloc(heap, buffers[k].size);
+        descriptors[k].ptr = a->malloc(heap, descriptors[k].size);
+        if (!buffers[k].ptr || !descriptors[k].ptr) {
+            printf("%s: stream allocation failed\n", a->name);
+            exit(1);
+        }
+        track_peak(heap, buffers[k].ptr, buffers[k].size, peak);
+        track_peak(heap, descriptors[k].ptr, descriptors[k].size, peak);
+    }
+    // Destroy half of the streams, so the heap is fragmented
+    for (int k = 0; k < STREAM_SLOTS / 2; k++) {
+        a->free(heap, buffers[k].ptr);
+        a->free(heap, descriptors[k].ptr);
+    }
+    return OPERATIONS;
+}
+
+int run_put(allocator* a, void* heap, uint32_t* peak) {
+    slot* buffers = calloc(PUT_SLOTS, sizeof(slot));
+    for (int i = 0; i < OPERATIONS; i++) {
+        int k = next_random() % PUT_SLOTS;
+        if (buffers[k].ptr)
+            a->free(heap, buffers[k].ptr);
+        buffers[k].size = 4 + (next_random() % 32) * 4;
+        buffers[k].ptr = a->malloc(heap, buffers[k].size);
+        if (!buffers[k].ptr) {
+            printf("%s: put allocation failed\n", a->name);
+            exit(1);
+        }
+        track_peak(heap, buffers[k].ptr, buffers[k].size, peak);
+    }
+    // Keep every other buffer, so the heap is fragmented
+    for (int k = 0; k < PUT_SLOTS; k += 2)
+        if (buffers[k].ptr)
+            a->free(heap, buffers[k].ptr);
+    free(buffers);
+    return OPERATIONS;
+}
+
+int run_large(allocator* a, void* heap, uint32_t* peak) {
+    int count = (HEAP_SIZE / 2) / STREAM_SIZE;
+    void** buffers = calloc(count, sizeof(void*));
+    for (int k = 0; k < count; k++) {
+        buffers[k] = a->malloc(heap, STREAM_SIZE);
+        if (!buffers[k]) {
+            printf("%s: large allocation failed\n", a->name);
+            exit(1);
+        }
+    }
+    for (int k = 0; k < count; k += 8)
+        a->free(heap, buffers[k]);
+
+    for (int i = 0; i < LARGE_OPERATIONS; i++) {
+        uint32_t size = 4 * STREAM_SIZE + (next_random() % 16) * 1024;
+        void* ptr = a->malloc(heap, size);
+        if (!ptr) {
+            printf("%s: large allocation failed\n", a->name);
+            exit(1);
+        }
+        track_peak(heap, ptr, size, peak);
+        a->free(heap, ptr);
+    }
+    free(buffers);
+    return count + LARGE_OPERATIONS;
+}
+
+workload workloads[] = {
+    {"stream", run_stream},
+    {"put", run_put},
+    {"large", run_large},
+};
+
+// Largest block that can be allocated, found by bisection
+uint32_t largest_block(allocator* a, void* heap) {
+    uint32_t low = 0;
+    uint32_t high = HEAP_SIZE;
+    while (low < high) {
+        uint32_t size = low + (high - low + 1) / 2;
+        void* ptr = a->malloc(heap, size);
+        if (ptr) {
+            a->free(heap, ptr);
+            low = size;
+        } else {
+            high = size - 1;
+        }
+    }
+    return low;
+}
+
+int main() {
+    allocator* allocators[] = {&bitmap_allocator, &size_class_allocator};
+    void* heap = malloc(HEAP_SIZE);
+
+    printf("%-8s %-14s %14s %12s %14s %12s %12s\n", "workload", "allocator",
+           "allocs/s", "peak (KB)", "largest (KB)", "free (KB)",
+           "lists (KB)");
+
+    int count = sizeof(workloads) / sizeof(workload);
+    for (int w = 0; w < count; w++) {
+        for (int i = 0; i < 2; i++) {
+            allocator* a = allocators[i];
+            a->init(heap, HEAP_SIZE);
+            random_state = 1;
+            uint32_t peak = 0;
+
+            double time = seconds();
+            int allocations = workloads[w].run(a, heap, &peak);
+            time = seconds() - time;
+
+            uint32_t used, free_bytes, list_bytes;
+            a->info(heap, &used, &free_bytes, &list_bytes);
+            printf("%-8s %-14s %14.0f %12u %14u %12u %12u\n",
+                   workloads[w].name, a->name, allocations / time, peak / 1024,
+                   largest_block(a, heap) / 1024, free_bytes / 1024,
+                   list_bytes / 1024);
+        }
+    }
+
+    free(heap);
+    return 0;
+}
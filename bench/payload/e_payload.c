@@ -0,0 +1,62 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "common.h"
+
+int target;
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int dst = (p + 1) % bsp_nprocs();
+    int tagsize = sizeof(int);
+    bsp_set_tagsize(&tagsize);
+    bsp_push_reg(&target, sizeof(int));
+    bsp_sync();
+
+    // All cores reserve payload space at the same time
+    unsigned int cycles[RESULTS] = {0};
+    for (int step = 0; step < SUPERSTEPS; step++) {
+        ebsp_barrier();
+        ebsp_raw_time();
+        for (int i = 0; i < PUTS; i++)
+            bsp_put(dst, &i, &target, 0, sizeof(int));
+        cycles[RESULT_PUT] += ebsp_raw_time();
+
+        ebsp_barrier();
+        ebsp_raw_time();
+        for (int i = 0; i < SENDS; i++)
+            bsp_send(dst, &i, &i, sizeof(int));
+        cycles[RESULT_SEND] += ebsp_raw_time();
+
+        bsp_sync();
+    }
+
+    // bsp_sync clears the messages to the host, so they are sent last
+    for (int tag = 0; tag < RESULTS; tag++)
+        ebsp_send_up(&tag, &cycles[tag], sizeof(unsigned int));
+
+    bsp_end();
+    return 0;
+}
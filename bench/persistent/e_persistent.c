@@ -0,0 +1,47 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "common.h"
+
+// A small job: read one integer from the host and send it back
+int main() {
+    do {
+        bsp_begin();
+
+        int value = 0;
+        int status = 0;
+        int tag = 0;
+        bsp_get_tag(&status, &tag);
+        if (status >= 0)
+            bsp_move(&value, sizeof(int));
+
+        bsp_sync();
+
+        value += 1;
+        ebsp_send_up(&tag, &value, sizeof(int));
+
+        bsp_end();
+    } while (ebsp_next_run());
+
+    return 0;
+}
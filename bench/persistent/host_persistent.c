@@ -0,0 +1,98 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Measures the number of small jobs per second when every job loads the
+// program with bsp_init and bsp_begin, and when the program is loaded
+// once and kept on the cores with ebsp_next_run.
+//
+// Usage: host_persistent [nprocs]
+
+#define _POSIX_C_SOURCE 199309L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "common.h"
+
+double seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+// Send a value to every core, run the program and check the results
+int run_job(int nprocs, int job) {
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+    for (int pid = 0; pid < nprocs; pid++)
+        ebsp_send_down(pid, &pid, &job, sizeof(int));
+
+    if (!ebsp_spmd())
+        return 0;
+
+    int packets, accum_bytes;
+    ebsp_qsize(&packets, &accum_bytes);
+    int correct = 0;
+    for (int i = 0; i < packets; i++) {
+        int tag, status, value;
+        ebsp_get_tag(&status, &tag);
+        ebsp_move(&value, sizeof(int));
+        if (value == job + 1)
+            correct++;
+    }
+    return correct == nprocs;
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_persistent.elf", argc, argv);
+    int nprocs = (argc > 1) ? atoi(argv[1]) : bsp_nprocs();
+    bsp_end();
+
+    printf("%-12s %12s %12s\n", "flow", "jobs/s", "ms/job");
+
+    // Every job loads the program
+    int errors = 0;
+    double t = seconds();
+    for (int job = 0; job < JOBS; job++) {
+        bsp_init("e_persistent.elf", argc, argv);
+        bsp_begin(nprocs);
+        errors += !run_job(nprocs, job);
+        bsp_end();
+    }
+    t = seconds() - t;
+    printf("%-12s %12.1f %12.3f\n", "reload", JOBS / t, 1.0e3 * t / JOBS);
+
+    // The program is loaded once
+    t = seconds();
+    bsp_init("e_persistent.elf", argc, argv);
+    bsp_begin(nprocs);
+    for (int job = 0; job < JOBS; job++)
+        errors += !run_job(nprocs, job);
+    bsp_end();
+    t = seconds() - t;
+    printf("%-12s %12.1f %12.3f\n", "persistent", JOBS / t, 1.0e3 * t / JOBS);
+
+    if (errors)
+        printf("%d jobs gave a wrong result\n", errors);
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Measures the latency of ebsp_host_sync and the CPU time used by the host
+// while polling, for several polling policies.
+//
+// Usage: host_poll_policy [cpu] [rt_priority]
+// With the optional arguments the polling thread is pinned to `cpu` and
+// runs with real-time priority `rt_priority`.
+
+#define _POSIX_C_SOURCE 199309L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "common.h"
+
+typedef struct {
+    const char* name;
+    ebsp_poll_mode mode;
+    int interval;
+    int spin_count;
+} policy_entry;
+
+policy_entry policies[] = {
+    {"spin", EBSP_POLL_SPIN, 0, 0},
+    {"backoff", EBSP_POLL_BACKOFF, 100, 1000},
+    {"interval 1us", EBSP_POLL_INTERVAL, 1, 0},
+    {"interval 100us", EBSP_POLL_INTERVAL, 100, 0},
+    {"interval 1ms", EBSP_POLL_INTERVAL, 1000, 0},
+};
+
+double seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+int main(int argc, char** argv) {
+    int cpu = (argc > 1) ? atoi(argv[1]) : -1;
+    int rt_priority = (argc > 2) ? atoi(argv[2]) : 0;
+
+    printf("%-16s %16s %10s\n", "policy", "host sync (us)", "CPU (%)");
+
+    int count = sizeof(policies) / sizeof(policy_entry);
+    for (int i = 0; i < count; i++) {
+        bsp_init("e_poll_policy.elf", argc, argv);
+
+        ebsp_poll_policy policy;
+        policy.mode = policies[i].mode;
+        policy.interval = policies[i].interval;
+        policy.spin_count = policies[i].spin_count;
+        policy.cpu = cpu;
+        policy.rt_priority = rt_priority;
+        ebsp_set_poll_policy(&policy);
+
+        bsp_begin(bsp_nprocs());
+
+        // The CPU time of this thread is the time spent polling
+        double wall = seconds(CLOCK_MONOTONIC);
+        double cpu_time = seconds(CLOCK_THREAD_CPUTIME_ID);
+        ebsp_spmd();
+        wall = seconds(CLOCK_MONOTONIC) - wall;
+        cpu_time = seconds(CLOCK_THREAD_CPUTIME_ID) - cpu_time;
+
+        bsp_end();
+
+        printf("%-16s %16.2f %10.1f\n", policies[i].name,
+               1.0e6 * wall / HOST_SYNCS, 100.0 * cpu_time / wall);
+    }
+
+    return 0;
+}
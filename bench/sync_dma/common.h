@@ -0,0 +1,30 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Sizes in bytes of the h-relations, where every core puts this many bytes
+// to the next core and gets this many bytes from the previous core
+#define SIZES 8
+#define MAX_SIZE 4096
+static const int sizes[SIZES] = {4, 32, 64, 128, 256, 1024, 2048, MAX_SIZE};
+
+// Number of syncs that are timed for every size
+#define SYNCS 20
@@ -0,0 +1,59 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "common.h"
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int n = bsp_nprocs();
+    char* target = ebsp_malloc(MAX_SIZE);
+    char* source = ebsp_malloc(MAX_SIZE);
+    char* result = ebsp_malloc(MAX_SIZE);
+    if (!target || !source || !result)
+        bsp_abort("Not enough local memory");
+
+    for (int i = 0; i < MAX_SIZE; i++)
+        source[i] = p;
+    bsp_push_reg(target, MAX_SIZE);
+    bsp_sync();
+
+    unsigned int cycles[SIZES] = {0};
+    for (int s = 0; s < SIZES; s++) {
+        for (int i = 0; i < SYNCS; i++) {
+            bsp_put((p + 1) % n, source, target, 0, sizes[s]);
+            bsp_get((p + n - 1) % n, target, 0, result, sizes[s]);
+            ebsp_raw_time();
+            bsp_sync();
+            cycles[s] += ebsp_raw_time();
+        }
+    }
+
+    // bsp_sync clears the messages to the host, so they are sent last
+    for (int s = 0; s < SIZES; s++)
+        ebsp_send_up(&s, &cycles[s], sizeof(unsigned int));
+
+    bsp_end();
+    return 0;
+}
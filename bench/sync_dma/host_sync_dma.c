@@ -0,0 +1,64 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Measures the time of bsp_sync against the size of the h-relation, where
+// the data of every request is copied by the cpu or by the DMA engine
+// depending on its size.
+//
+// Usage: host_sync_dma [nprocs]
+
+#include <host_bsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+
+int main(int argc, char** argv) {
+    bsp_init("e_sync_dma.elf", argc, argv);
+    int nprocs = (argc > 1) ? atoi(argv[1]) : bsp_nprocs();
+    bsp_begin(nprocs);
+
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+    ebsp_spmd();
+
+    // Average of the cores
+    double cycles[SIZES] = {0};
+    int packets, accum_bytes;
+    ebsp_qsize(&packets, &accum_bytes);
+    for (int i = 0; i < packets; i++) {
+        int tag, status;
+        unsigned int value;
+        ebsp_get_tag(&status, &tag);
+        ebsp_move(&value, sizeof(unsigned int));
+        if (tag >= 0 && tag < SIZES)
+            cycles[tag] += (double)value / nprocs;
+    }
+
+    bsp_end();
+
+    printf("%8s %14s %14s\n", "h", "cycles/sync", "cycles/byte");
+    for (int i = 0; i < SIZES; i++)
+        printf("%8d %14.1f %14.2f\n", sizes[i], cycles[i] / SYNCS,
+               cycles[i] / SYNCS / sizes[i]);
+
+    return 0;
+}
@@ -310,7 +310,6 @@ int main() {
         ebsp_move_chunk_up((void**)&pi_out, 1, 0);
     }
 
-    ebsp_free(matrix);
     ebsp_free(loc_rs);
     ebsp_free(loc_ark);
     ebsp_free(loc_pi);
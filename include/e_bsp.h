@@ -65,6 +65,32 @@ void bsp_begin();
  */
 void bsp_end();
 
+/**
+ * Wait until the host runs the program again.
+ * @return 1 if the program should run again, 0 if the host called bsp_end()
+ *
+ * This allows the host to call ebsp_spmd() multiple times without loading
+ * the program again. The core waits until the host calls ebsp_spmd() or
+ * bsp_end(). It must be called after bsp_end(), as follows:
+ *
+ * \code{.c}
+ * int main() {
+ *     do {
+ *         bsp_begin();
+ *         ...
+ *         bsp_end();
+ *     } while (ebsp_next_run());
+ *     return 0;
+ * }
+ * \endcode
+ *
+ * The BSP state of the core, such as registered variables and local
+ * memory allocated with ebsp_malloc(), is reset. Global variables of the
+ * program itself keep their values, and memory allocated with
+ * ebsp_ext_malloc() is not freed.
+ */
+int ebsp_next_run();
+
 /**
  * Obtain the number of Epiphany cores currently in use.
  * @return An integer indicating the number of cores on which the program runs.
@@ -135,6 +161,10 @@ float ebsp_host_time();
  * If only a synchronization is required, and you do not want the outstanding
  * communications and registrations to be resolved, then we suggest you use the
  * more efficient function ebsp_barrier()
+ *
+ * Requests of 128 bytes or more are copied by the DMA engine. These tasks
+ * are added after any tasks of ebsp_dma_push() that are not finished, so
+ * those are finished when bsp_sync() returns.
  */
 void bsp_sync();
 
@@ -167,8 +197,7 @@ void ebsp_host_sync();
  * The system maintains a stack of registered variables. Any variables
  * registered in the same superstep are identified with each other. There
  * is a maximum number of allowed registered variables at any given time,
- * the specific number is platform dependent. This limit will be lifted
- * in a future version.
+ * which is 20 unless the host changes it with ebsp_set_max_bsp_vars().
  *
  * Registering a variable needs to be done before it can be used with
  * the functions bsp_put(), bsp_hpput(), bsp_get(), bsp_hpget().
@@ -252,6 +281,9 @@ void bsp_put(int pid, const void* src, void* dst, int offset, int nbytes);
  *
  * @remarks No warning is thrown when nbytes exceeds the size of the variable
  *          src.
+ * @remarks The remote addresses of the four most recently used variables
+ *          are cached, so calls with these variables do not have to read
+ *          the address from the other processor.
 */
 void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes);
 
@@ -267,7 +299,10 @@ void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes);
  * @param nbytes The number of bytes to be copied
  *
  * No data transaction takes place until the next call to bsp_sync, at which
- * point the data will be copied from source to destination.
+ * point the data will be copied from source to destination. When the host
+ * turned this on with ebsp_set_get_inbox_size(), the request is sent to
+ * processor `pid`, which writes the data to this processor, because
+ * writing to another core is much faster than reading from it.
  *
  * @remarks The official BSP standard dictates that first all the data of all
  * bsp_get() transactions is copied into a buffer, after which all the data is
@@ -305,6 +340,217 @@ void bsp_get(int pid, const void* src, int offset, void* dst, int nbytes);
  */
 void bsp_hpget(int pid, const void* src, int offset, void* dst, int nbytes);
 
+/**
+ * Copy data from another processor, which writes it to this processor.
+ * @param pid The pid of the target processor (this is allowed to be the id
+ *  of the sending processor)
+ * @param src A variable that has been previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes to be added to the remote location
+ *  corresponding to the variable location `src`
+ * @param dst A pointer to a local destination
+ * @param nbytes The number of bytes to be copied
+ *
+ * This is an unbuffered get like bsp_hpget(), but instead of reading the
+ * data, this processor asks processor `pid` to write it. That processor
+ * does so when it enters ebsp_barrier() or bsp_sync(). The destination
+ * holds the data after the next bsp_sync(), or after the second call of
+ * ebsp_barrier(). The data is copied at some point between the call of
+ * this function and that moment, so the source should not change in the
+ * meantime.
+ *
+ * Every processor can have as many of these requests waiting on another
+ * processor as the host sets with ebsp_set_get_inbox_size(), which is none
+ * by default. When there are more, the data is read at once like
+ * bsp_hpget(). Requests of bsp_get() do not count, and do not delay these
+ * requests.
+ *
+ * @remarks No warning is thrown when nbytes exceeds the size of the variable
+ *          src.
+ */
+void ebsp_hpget_push(int pid, const void* src, int offset, void* dst,
+                     int nbytes);
+
+/**
+ * Copy blocks of data to another processor with a single bsp_put().
+ * @param pid The pid of the target processor (this is allowed to be the id
+ *  of the sending processor)
+ * @param src A pointer to the first block of local source data
+ * @param dst A variable location that was previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes of the first block, to be added to the
+ *  remote location corresponding to the variable location `dst`
+ * @param count The number of blocks
+ * @param nbytes The size of a block in bytes
+ * @param src_stride The distance in bytes between the starts of two blocks
+ *  in the source
+ * @param dst_stride The distance in bytes between the starts of two blocks
+ *  in the destination
+ *
+ * This does the same as `count` calls of bsp_put(), but takes two of the
+ * 128 requests per superstep instead of `count`. Like bsp_put(), the data
+ * is copied when this function is called, and written to the destination
+ * in the next bsp_sync(). There the blocks are copied by a single DMA task
+ * when the strides fit in the DMA engine, for example to send a column of
+ * a matrix:
+ *
+ * \code{.c}
+ * float matrix[8][8];
+ * // Column 2 of this core becomes row 5 on core 1
+ * ebsp_put_strided(1, &matrix[0][2], &matrix, 5 * 8 * sizeof(float), 8,
+ *                  sizeof(float), 8 * sizeof(float), sizeof(float));
+ * \endcode
+ *
+ * @remarks No warning is thrown when the blocks exceed the size of the
+ *          variable dst.
+ */
+void ebsp_put_strided(int pid, const void* src, void* dst, int offset,
+                      int count, int nbytes, int src_stride, int dst_stride);
+
+/**
+ * Copy blocks of data from another processor with a single bsp_get().
+ * @param pid The pid of the target processor (this is allowed to be the id
+ *  of the sending processor)
+ * @param src A variable that has been previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes of the first block, to be added to the
+ *  remote location corresponding to the variable location `src`
+ * @param dst A pointer to the first block of the local destination
+ * @param count The number of blocks
+ * @param nbytes The size of a block in bytes
+ * @param src_stride The distance in bytes between the starts of two blocks
+ *  in the source
+ * @param dst_stride The distance in bytes between the starts of two blocks
+ *  in the destination
+ *
+ * This does the same as `count` calls of bsp_get(), but takes two of the
+ * 128 requests per superstep instead of `count`. The data is copied in the
+ * next bsp_sync(), by a single DMA task when the strides fit in the DMA
+ * engine. See ebsp_put_strided().
+ *
+ * @remarks No warning is thrown when the blocks exceed the size of the
+ *          variable src.
+ */
+void ebsp_get_strided(int pid, const void* src, int offset, void* dst,
+                      int count, int nbytes, int src_stride, int dst_stride);
+
+/**
+ * Atomically add to an integer on another processor.
+ * @param pid The pid of the processor that owns the integer (this is
+ *  allowed to be the id of the calling processor)
+ * @param variable A variable that has been previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes of the integer, to be added to the
+ *  remote location corresponding to the variable location `variable`
+ * @param value The number to add
+ * @return The value of the integer before the addition
+ *
+ * The operation takes effect immediately, like bsp_hpput(), so no
+ * bsp_sync() is needed. For example, cores can take the next piece of
+ * work from a counter on processor 0:
+ *
+ * \code{.c}
+ * int next = 0;
+ * bsp_push_reg(&next, sizeof(int));
+ * bsp_sync();
+ *
+ * int task;
+ * while ((task = ebsp_atomic_fetch_add(0, &next, 0, 1)) < ntasks)
+ *     do_task(task);
+ * \endcode
+ *
+ * @remarks The atomic operations on the variables of a processor take
+ * turns using a mutex on that processor. They are only atomic with respect
+ * to each other, not to other writes such as bsp_hpput().
+ * @remarks The integer must be 4-byte aligned.
+ */
+int ebsp_atomic_fetch_add(int pid, void* variable, int offset, int value);
+
+/**
+ * Atomically replace an integer on another processor.
+ * @param pid The pid of the processor that owns the integer
+ * @param variable A variable that has been previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes of the integer
+ * @param value The new value
+ * @return The value of the integer before it was replaced
+ *
+ * See ebsp_atomic_fetch_add().
+ */
+int ebsp_atomic_swap(int pid, void* variable, int offset, int value);
+
+/**
+ * Atomically compare and replace an integer on another processor.
+ * @param pid The pid of the processor that owns the integer
+ * @param variable A variable that has been previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes of the integer
+ * @param expected The value that the integer should have
+ * @param desired The new value, which is only written if the integer was
+ *  equal to `expected`
+ * @return The value of the integer before the operation. The integer was
+ *  replaced if this is equal to `expected`
+ *
+ * See ebsp_atomic_fetch_add().
+ */
+int ebsp_atomic_cas(int pid, void* variable, int offset, int expected,
+                    int desired);
+
+/**
+ * Copy data to another processor, and then notify it.
+ * @param pid The pid of the target processor (this is allowed to be the id
+ *  of the sending processor)
+ * @param src A pointer to local source data
+ * @param dst A variable location that was previously registered using
+ *  bsp_push_reg()
+ * @param offset The offset in bytes to be added to the remote location
+ *  corresponding to the variable location `dst`
+ * @param nbytes The number of bytes to be copied
+ * @param flag An integer variable that was previously registered using
+ *  bsp_push_reg(), which counts the notifications
+ *
+ * The data is copied immediately, like bsp_hpput(). Then the counter
+ * `flag` on processor `pid` is incremented with ebsp_atomic_fetch_add().
+ * The receiver calls ebsp_wait_notify(), after which the data is
+ * available. This way two processors can pass data without
+ * ebsp_barrier(), which waits for all processors.
+ *
+ * \code{.c}
+ * int s = bsp_pid();
+ * int result = 100 + s;
+ * int data[16];
+ * int received = 0;
+ * bsp_push_reg(&data, sizeof(data));
+ * bsp_sync();
+ * bsp_push_reg(&received, sizeof(int));
+ * bsp_sync();
+ *
+ * if (s == 0)
+ *     ebsp_put_notify(1, &result, &data, 0, sizeof(result), &received);
+ * if (s == 1) {
+ *     ebsp_wait_notify(&received, 1);
+ *     // The result of processor 0 is in data[0]
+ * }
+ * \endcode
+ *
+ * @remarks The notification is only guaranteed to arrive after the data
+ * when `dst` is in the local memory of processor `pid`.
+ */
+void ebsp_put_notify(int pid, const void* src, void* dst, int offset,
+                     int nbytes, void* flag);
+
+/**
+ * Wait for notifications of ebsp_put_notify().
+ * @param flag The integer variable that counts the notifications, which
+ *  was given to ebsp_put_notify() on the other processors
+ * @param count The number of notifications to wait for
+ *
+ * Waits until the counter is at least `count`, and then subtracts
+ * `count` from it. Notifications that arrive later stay in the counter for
+ * the next call.
+ */
+void ebsp_wait_notify(void* flag, int count);
+
 /**
  * Obtain the tag size.
  * @return The tag size in bytes
@@ -568,6 +814,11 @@ int bsp_stream_move_up(ebsp_stream* stream, const void* data, int data_size, int
  * When no more space is available, the function will return zero.
  * Note that it is not allowed to call ebsp_free() with a zero pointer so
  * this should always be checked.
+ *
+ * The external memory is shared by all cores, so allocations wait for each
+ * other. When the host sets a size with ebsp_set_ext_arena_size(), small
+ * allocations come from a private arena of the core instead. Only this
+ * core can free those, also in a later run of ebsp_next_run().
  */
 void* ebsp_ext_malloc(unsigned int nbytes);
 
@@ -586,6 +837,25 @@ void* ebsp_ext_malloc(unsigned int nbytes);
  */
 void* ebsp_malloc(unsigned int nbytes);
 
+/**
+ * Allocate local memory in a given memory bank.
+ * @param nbytes The size of the memory block
+ * @param bank The memory bank, from 0 to 3
+ * @return A pointer to the allocated memory, guaranteed to be 8-byte aligned
+ * to ensure fast transfers, or zero on error.
+ *
+ * The local memory consists of four banks of 8 KB. The DMA engine and the
+ * CPU can access different banks at the same time, but stall each other
+ * when they use the same bank. Buffers that are filled by the DMA engine
+ * while the CPU computes on other buffers should therefore be in a
+ * different bank. Note that bank 0 holds the program code, and the last
+ * bank holds the stack.
+ *
+ * When the bank has no room for the block, the memory is allocated in any
+ * bank, like ebsp_malloc(). The memory should be freed with ebsp_free().
+ */
+void* ebsp_malloc_bank(unsigned int nbytes, int bank);
+
 /**
  * Free allocated external or local memory.
  * @param ptr A pointer to memory previously allocated by ebsp_ext_malloc()
@@ -596,6 +866,47 @@ void* ebsp_malloc(unsigned int nbytes);
  */
 void ebsp_free(void* ptr);
 
+/**
+ * Get the current position in the scratch memory of the core.
+ * @return A mark for ebsp_scratch_release()
+ *
+ * Scratch memory is local memory for temporary buffers. Allocating it only
+ * moves a cursor, and all buffers that were allocated after a mark are freed
+ * at once by ebsp_scratch_release(). For example:
+ * \code{.c}
+ * void* mark = ebsp_scratch_mark();
+ * float* tile_a = ebsp_scratch_alloc(32 * 32 * sizeof(float));
+ * float* tile_b = ebsp_scratch_alloc(32 * 32 * sizeof(float));
+ * // ... compute with the tiles
+ * ebsp_scratch_release(mark);
+ * \endcode
+ * The scratch memory is taken from the memory of ebsp_malloc() in blocks
+ * of at least 1 KB, when it is needed.
+ */
+void* ebsp_scratch_mark();
+
+/**
+ * Allocate scratch memory.
+ * @param nbytes The size of the memory block
+ * @return A pointer to the allocated memory, guaranteed to be 8-byte aligned,
+ * or zero on error.
+ *
+ * The memory is freed by ebsp_scratch_release() with a mark that was
+ * obtained before this call, and must not be passed to ebsp_free().
+ * Like ebsp_malloc(), this returns zero when the memory would overwrite
+ * the stack.
+ */
+void* ebsp_scratch_alloc(unsigned int nbytes);
+
+/**
+ * Free all scratch memory that was allocated after a mark.
+ * @param mark A mark obtained by ebsp_scratch_mark()
+ *
+ * Blocks of scratch memory that are no longer needed are returned
+ * to ebsp_malloc().
+ */
+void ebsp_scratch_release(void* mark);
+
 /**
  * Push a new task to the DMA engine. See the documentation on Memory
  * Management for details on the DMA engine.
@@ -708,12 +1019,35 @@ void ebsp_memcpy(void* dst, const void* src, size_t nbytes);
  *
  * ebsp_message() outputs a debug message by sending it to shared memory
  * So that the host processor can output it to the terminal
+ * The core does not wait for the host, unless its buffer in shared memory
+ * is full, see ebsp_set_log_policy() on the host. The messages of a
+ * superstep are printed in the order of the processor ids.
  * The attributes in this definition make sure that the compiler checks the
  * arguments for errors.
  */
 void ebsp_message(const char* format, ...)
     __attribute__((__format__(__printf__, 1, 2)));
 
+/**
+ * Output a debug message printf style, formatted by the host.
+ * @param format The formatting string in printf style
+ *
+ * This works like ebsp_message(), but the core does not format the message.
+ * It only writes the address of `format` and the values of the arguments to
+ * shared memory, and the host reads the format string from the program on
+ * the core when it prints the message. This takes a few stores instead of a
+ * call to `vsnprintf`, and programs that do not use ebsp_message() or
+ * bsp_abort() do not link the large printf code of the C library.
+ *
+ * @remarks
+ * `format` has to be a string in the program itself, such as a string
+ * literal, because the host reads it after the call. The strings for `%s`
+ * are copied. The arguments can take up to 120 bytes, and `long double`
+ * is not supported.
+ */
+void ebsp_message_deferred(const char* format, ...)
+    __attribute__((__format__(__printf__, 1, 2)));
+
 /**
  * Aborts the program after outputting a message.
  * @param format The formatting string in printf style
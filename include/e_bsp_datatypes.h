@@ -42,4 +42,14 @@ typedef struct {
     unsigned max_chunksize; // maximum size of a token exluding 8 byte header
 } __attribute__((aligned(8))) ebsp_stream;
 
-
+// Statistics of a heap, see ebsp_get_malloc_stats(). Sizes are in bytes and
+// include the 8 byte header of every block, rounded up to 8 bytes
+typedef struct {
+    unsigned live_bytes;       // Allocated and not freed yet
+    unsigned peak_bytes;       // Maximum of live_bytes
+    unsigned allocs;           // Number of allocations
+    unsigned frees;            // Number of calls to ebsp_free
+    unsigned failed;           // Allocations that returned 0
+    unsigned largest_free_run; // Size of the largest block that is free
+    unsigned free_list_bytes;  // Free blocks kept for MALLOC_SIZE_CLASSES
+} ebsp_malloc_stats;
@@ -31,8 +31,83 @@ see the files COPYING and COPYING.LESSER. If not, see
 // Use this define to place functions or variables in external memory
 // TEXT is for functions and normal variables
 // RO is for read only globals
+// The emulator has no external code memory, so there they have no effect
+#ifdef EBSP_EMULATOR
+#define EXT_MEM_TEXT
+#define EXT_MEM_RO
+#else
 #define EXT_MEM_TEXT __attribute__((section("EBSP_TEXT")))
 #define EXT_MEM_RO __attribute__((section("EBSP_RO")))
+#endif
+
+// Interrupt handlers need a special prologue and epilogue on the chip.
+// In the emulator they are called as normal functions.
+#ifdef EBSP_EMULATOR
+#define INTERRUPT_HANDLER
+#else
+#define INTERRUPT_HANDLER __attribute__((interrupt))
+#endif
+
+// Body of loops that wait for the host. Every core of the emulator is
+// a thread, so there it gives up the CPU to the thread it waits for
+#ifdef EBSP_EMULATOR
+#define SPIN_WAIT() e_emu_yield()
+#else
+#define SPIN_WAIT()
+#endif
+
+// Makes the writes to external memory before it visible to the host before
+// the writes after it. The chip keeps writes to external memory in order
+#ifdef EBSP_EMULATOR
+#define WRITE_FENCE() __sync_synchronize()
+#else
+#define WRITE_FENCE()
+#endif
+
+// The local memory consists of four banks of 8 KB, which the DMA engine
+// and the CPU can use at the same time
+#define LOCAL_BANKS 4
+#define LOCAL_BANK_SIZE 0x2000
+
+// Remote addresses of a BSP variable on every core, see _get_remote_addr.
+// A zero address has not been read from the other core yet
+#define VAR_CACHE_SIZE 4
+
+typedef struct {
+    const void* variable; // 0 for an empty entry
+    void* remote[NPROCS];
+} ebsp_var_cache_entry;
+
+// Gets that other cores forwarded to this core, which writes the data to
+// them, see _forward_get. There is one inbox for bsp_get and one for
+// ebsp_hpget_push, with get_inbox_size requests of every other core.
+// head[pid] is written by core pid, and tail[pid] is read by core pid when
+// its requests seem to fill the inbox. sent and served are the copies of
+// head and tail of this core on the other cores
+typedef struct {
+    volatile uint32_t head[NPROCS];
+    uint32_t tail[NPROCS];
+    uint32_t sent[NPROCS];
+    uint32_t served[NPROCS];
+    volatile ebsp_data_request requests[];
+} ebsp_get_inbox;
+
+#define GET_INBOX_SYNC 0 // bsp_get, served in bsp_sync
+#define GET_INBOX_HP 1   // ebsp_hpget_push, also served in ebsp_barrier
+
+// Requests of at least SYNC_DMA_MIN_SIZE bytes are copied by the DMA
+// engine in bsp_sync, in pieces of at most SYNC_DMA_CHUNK bytes so that
+// the count fits in a descriptor. See _sync_copy
+#define SYNC_DMA_MIN_SIZE 128
+#define SYNC_DMA_CHUNK 0x8000
+#define SYNC_DMA_DESCRIPTORS 4
+
+// A bsp_put in the local put buffer, followed by its payload. Every entry
+// starts at a multiple of 8 bytes, see ebsp_set_put_buffer_size
+typedef struct {
+    void* dst;
+    uint32_t nbytes;
+} ebsp_put_header;
 
 // All internal bsp variables for this core
 // 8-bit variables (mutexes) are grouped together
@@ -44,17 +119,54 @@ typedef struct {
     int32_t pid;
     int32_t nprocs;
 
+    // Communication buffer of the workgroup of this core
+    ebsp_combuf* combuf_addr;
+
     uint16_t coreids[NPROCS]; // pid to coreid mapping
 
     // time_passed is epiphany cpu time (so not walltime) in seconds
     float time_passed;
 
-    // BSP variable list
-    void* bsp_var_list[MAX_BSP_VARS];
+    // BSP variable list of max_bsp_vars slots, in local memory at the same
+    // address on every core. The slots of a variable are found with a hash
+    // table of var_buckets lists, where var_next links the slots
+    // Slot numbers in these lists are one higher, so that 0 ends a list
+    void** bsp_var_list;
+    uint32_t max_bsp_vars;
+    uint16_t* var_buckets;
+    uint16_t* var_next;
+    uint32_t var_bucket_mask; // Number of buckets minus one
+
+    // Recently used BSP variables, and the changes of bsp_push_reg and
+    // bsp_pop_reg since the last bsp_sync
+    ebsp_var_cache_entry var_cache[VAR_CACHE_SIZE];
+    uint32_t var_cache_next;               // Entry that is replaced next
+    int32_t vars_changed;                  // 1 after a push or pop
+    uint32_t vars_pushed;                  // Number of pushes
+    uint32_t var_pushed_slot[VAR_CACHE_SIZE]; // Slots of the last pushes
 
     // counter for ebsp_combuf::data_requests[pid]
     uint32_t request_counter;
 
+    // Chunk of ebsp_combuf::data_payloads for the payloads of this core,
+    // which are 8-byte aligned so that the DMA engine copies whole words
+    char* payload_chunk;
+    uint32_t payload_chunk_size;
+    uint32_t payload_used;
+
+    // Local buffer of bsp_put, of which put_buffer_used bytes are in use.
+    // After a put that did not fit, put_buffer_full is 1 until the next
+    // bsp_sync, so that the puts are done in the order of the calls
+    char* put_buffer;
+    uint32_t put_buffer_size;
+    uint32_t put_buffer_used;
+    int32_t put_buffer_full;
+
+    // Inboxes of forwarded gets, in local memory at the same address on
+    // every core, see ebsp_set_get_inbox_size. 0 when it is turned off
+    ebsp_get_inbox* get_inbox[2];
+    uint32_t get_inbox_size;
+
     // message_index is an index into an epiphany<->epiphany queue and
     // when it reached the end, it is an index into the arm->epiphany queue
     uint32_t tagsize;
@@ -62,14 +174,24 @@ typedef struct {
     uint32_t read_queue_index;
     uint32_t message_index;
 
+    // Copies of the fields of the log ring of this core, see ebsp_log_ring.
+    // log_tail is only read again from external memory when the ring
+    // seems to be full
+    uint32_t log_head;
+    uint32_t log_tail;
+    uint32_t log_epoch;
+    uint32_t log_dropped;
+
     // bsp_sync barrier
     volatile e_barrier_t sync_barrier[NPROCS];
     volatile e_barrier_t* sync_barrier_tgt[NPROCS];
 
+    // The fields from here up to local_malloc_base are kept by
+    // ebsp_next_run
     // Mutex is used for message_queue (send) and data_payloads (put)
     e_mutex_t payload_mutex;
 
-    // Mutex for ebsp_message
+    // Mutex for formatting in ebsp_message, which is not thread safe
     e_mutex_t ebsp_message_mutex;
 
     // Mutex for opening a stream
@@ -78,9 +200,31 @@ typedef struct {
     // Mutex for ebsp_ext_malloc (internal malloc does not have mutex)
     e_mutex_t malloc_mutex;
 
+    // Mutex for the atomic operations on the variables of this core,
+    // see ebsp_atomic_fetch_add
+    e_mutex_t atomic_mutex;
+
+    // Private part of the ebsp_ext_malloc memory, reserved on the first
+    // call. Allocations move the cursor, and it is reset when all of them
+    // are freed. It is kept by ebsp_next_run while allocations are left
+    void* ext_arena_start;
+    void* ext_arena_cursor;
+    void* ext_arena_end;
+    uint32_t ext_arena_live; // Allocations that were not freed yet
+    int32_t ext_arena_reserved; // 1 after the first ebsp_ext_malloc
+
     // Base address of malloc table for internal malloc
     void* local_malloc_base;
 
+    // First chunk of the local heap in every memory bank, and the end of
+    // the heap, see ebsp_malloc_bank
+    uint32_t local_bank_chunk[LOCAL_BANKS + 1];
+
+    // Current block of scratch memory, see ebsp_scratch_alloc
+    void* scratch_block;
+    void* scratch_cursor;
+    void* scratch_end;
+
     // Location of local copy of combuf.extmem_in_streams
     ebsp_stream_descriptor* local_streams;
 
@@ -92,6 +236,12 @@ typedef struct {
     e_dma_desc_t* cur_dma_desc;
     e_dma_desc_t* last_dma_desc;
 
+    // Descriptors of _sync_copy, which are used in turn, and the number
+    // of them that were pushed since the last _sync_copy_wait
+    ebsp_dma_handle sync_dma[SYNC_DMA_DESCRIPTORS];
+    uint32_t sync_dma_next;
+    uint32_t sync_dma_pushed;
+
     // Global-space pointer to local DMA1CONFIG and DMA1STATUS cpu registers
     unsigned* dma1config;
     unsigned* dma1status;
@@ -99,9 +249,43 @@ typedef struct {
 
 extern ebsp_core_data coredata;
 
-// The define is faster; it saves a pointer lookup
-#define combuf ((ebsp_combuf*)E_COMBUF_ADDR)
-// ebsp_combuf * const combuf = (ebsp_combuf*)E_COMBUF_ADDR;
+// Every workgroup has its own combuf, so the address is only known
+// after bsp_begin. The pointer lookup is a single local memory read
+#define combuf (coredata.combuf_addr)
+
+// Memory for ebsp_ext_malloc, right after combuf
+#define dynmem ((void*)((uintptr_t)combuf + COMBUF_SIZE))
 
 void _init_local_malloc();
 
+void _release_ext_arena();
+
+void _write_malloc_stats();
+
+void _init_var_list();
+
+void _init_put_buffer();
+
+void _init_get_inbox();
+
+void _flush_put_buffer();
+
+void _serve_gets(int all);
+
+void* _reserve_payload(unsigned int nbytes);
+
+void _sync_copy(void* dst, const void* src, unsigned int nbytes);
+
+void _sync_copy_strided(void* dst, const void* src, unsigned int nbytes,
+                        unsigned int count, int dst_stride, int src_stride);
+
+void _sync_copy_wait();
+
+void _update_var_cache();
+
+void* _malloc_apart(unsigned int nbytes, const void* other);
+
+void _write_syncstate(int8_t state);
+
+void _log_write(const void* data, int length, uint32_t flags);
+
@@ -28,9 +28,10 @@ see the files COPYING and COPYING.LESSER. If not, see
 
 // Every variable that is registered with bsp_push_reg
 // gives 16 addresses (the locations on the different cores).
-// An address takes 4 bytes, and MAX_BSP_VARS is the maximum
+// An address takes 4 bytes, and MAX_BSP_VARS is the default maximum
 // amount of variables that can be registered so in total we need
-// NCORES * MAX_BSP_VARS * 4 bytes to save all this data
+// NCORES * MAX_BSP_VARS * 4 bytes to save all this data.
+// The host can change the maximum with ebsp_set_max_bsp_vars
 #define MAX_BSP_VARS 20
 
 // The maximum amount of buffered put/get operations each
@@ -44,8 +45,20 @@ see the files COPYING and COPYING.LESSER. If not, see
 // This is shared amongst all cores!
 #define MAX_PAYLOAD_SIZE (16 * 0x8000)
 
+// The cores take the payload buffer in chunks of this size, see
+// _reserve_payload
+#define PAYLOAD_CHUNK_SIZE 0x800
+
+// Maximum size of the local buffer for bsp_put, see ebsp_set_put_buffer_size
+#define MAX_PUT_BUFFER_SIZE 0x4000
+
+// Maximum number of forwarded gets per pair of cores, see
+// ebsp_set_get_inbox_size
+#define MAX_GET_INBOX_SIZE 64
+
 // See ebsp_data_request::nbytes
 #define DATA_PUT_BIT (1 << 31)
+#define DATA_STRIDED_BIT (1 << 30)
 
 // Structures that are shared between ARM and epiphany
 // need to use the same alignment
@@ -65,17 +78,26 @@ typedef struct {
 
     // The highest bit of nbytes is used to indicate whether this is a
     // put or a get request. 0 means get, 1 means put
+    // The next bit is set for a strided request, which is followed by an
+    // ebsp_data_strides in the next slot. Then nbytes is the size of a block
     int nbytes;
 } ebsp_data_request;
 
+// Second slot of a request of ebsp_put_strided or ebsp_get_strided
+typedef struct {
+    int count;
+    int src_stride;
+    int dst_stride;
+} ebsp_data_strides;
+
 // bsp_put calls need to save the data payload
 // Instead of having a separate buffer for each core there is one large
 // buffer used for all cores together. This is because there are many
 // applications that require a single core sending huge amounts of data
-// while other cores send nothing. Since all cores access the same
-// buffer there is a payload_mutex to ensure correctness
+// while other cores send nothing. Every core takes a chunk of the buffer
+// at a time, and only takes the payload_mutex when that chunk is full
 typedef struct {
-    unsigned int buffer_size; // buffer used so far
+    unsigned int buffer_size; // used so far, a multiple of 8
     char buf[MAX_PAYLOAD_SIZE];
 } ebsp_payload_buffer;
 
@@ -94,6 +116,34 @@ typedef struct {
     ebsp_message_header message[MAX_MESSAGES];
 } ebsp_message_queue;
 
+// Every core writes the output of ebsp_message to its own log ring,
+// which the host prints while it polls. There is a single writer and a
+// single reader, so neither has to lock or wait for the other
+#define LOG_RING_SIZE 2048
+
+// Maximum size of the contents of a record, including the terminating
+// zero of a text message
+#define LOG_MESSAGE_SIZE 128
+
+// Set in ebsp_log_header::length when the record holds the address of a
+// format string and its arguments instead of text, see ebsp_message_deferred
+#define LOG_DEFERRED_BIT (1u << 31)
+
+// A record in a log ring is this header followed by `length` bytes,
+// and starts at a multiple of 8 bytes
+typedef struct {
+    uint32_t epoch; // Value of ebsp_log_ring::epoch when it was written
+    uint32_t length;
+} ebsp_log_header;
+
+typedef struct {
+    uint32_t head;    // Bytes written, only written by the core
+    uint32_t tail;    // Bytes read, only written by the host
+    uint32_t epoch;   // Number of barriers the core has passed
+    uint32_t dropped; // Number of messages that did not fit
+    char buf[LOG_RING_SIZE];
+} ebsp_log_ring;
+
 typedef struct {
     void* extmem_addr;          // extmem data in e_core address space
     void* cursor;               // current position of the stream in extmem
@@ -113,30 +163,50 @@ typedef struct {
 
 typedef struct {
     // Epiphany --> ARM communication
+    // The host only polls syncstate and interrupts, which are kept
+    // together at the start so that they fit in a single cache line
     int8_t syncstate[NPROCS];
-    int8_t* syncstate_ptr; // Location on epiphany core
-    char msgbuf[128];      // shared by all cores (mutexed)
     uint16_t interrupts[NPROCS];
+    int8_t* syncstate_ptr; // Location on epiphany core
 
     // ARM --> Epiphany
     float remotetimer;
     int32_t nprocs;
     int32_t tagsize; // Only for initial and final messages
+    int32_t log_drop; // 1 to drop messages when a log ring is full
+    uint32_t ext_arena_size; // See ebsp_set_ext_arena_size
+    uint32_t max_bsp_vars;   // See ebsp_set_max_bsp_vars
+    uint32_t put_buffer_size; // See ebsp_set_put_buffer_size
+    uint32_t get_inbox_size;  // See ebsp_set_get_inbox_size
+    // Heap of ebsp_ext_malloc on the host while the cores run, which the
+    // cores must not free from. See ebsp_set_host_heap_size
+    void* host_heap;
+    uint32_t host_heap_size;
     // Deprecated streams
     int n_streams[NPROCS];
     void* extmem_streams[NPROCS];
     // New streams
     int32_t nstreams;
     ebsp_stream_descriptor* streams;
+    // Workgroups of ebsp_group_begin. Only used in the ebsp_combuf at
+    // E_COMBUF_ADDR: the core with coreid group_coreid[i] uses the
+    // ebsp_combuf at group_combuf[i]. The list ends with a zero coreid
+    uint16_t group_coreid[NPROCS];
+    void* group_combuf[NPROCS];
 
     // Epiphany <--> Epiphany
     ebsp_data_request data_requests[NPROCS][MAX_DATA_REQUESTS];
     ebsp_message_queue message_queue[2];
     ebsp_payload_buffer data_payloads; // used for put/get/send
+    ebsp_log_ring log[NPROCS];         // used for ebsp_message
+
+    // Epiphany --> ARM, statistics of the local heaps, written in bsp_end
+    ebsp_malloc_stats local_malloc_stats[NPROCS];
 } ebsp_combuf;
 
 // Right after combuf there is the memory used for mallocs
-// all the way till the end of external memory
+// all the way till the end of external memory. A workgroup of
+// ebsp_group_begin gets a slice of it for its own combuf and mallocs
 
 #pragma pack(pop)
 
@@ -144,13 +214,22 @@ typedef struct {
 // https://github.com/buurlage-wits/epiphany-bsp/wiki/Memory-on-the-parallella
 
 // Sizes within external memory
+// Part of ebsp_combuf that is polled by the host in ebsp_spmd
+#define COMBUF_POLL_SIZE (offsetof(ebsp_combuf, syncstate_ptr))
+
 #define EXTMEM_SIZE 0x02000000 // Total size, 32 MB
 #define NEWLIB_SIZE 0x01800000
 #define COMBUF_SIZE sizeof(ebsp_combuf)
 #define DYNMEM_SIZE (EXTMEM_SIZE - COMBUF_SIZE - NEWLIB_SIZE)
 
 // Epiphany addresses
+#ifdef EBSP_EMULATOR
+// The emulator allocates external memory at runtime, see src/emulator
+extern void* e_emu_extmem;
+#define E_EXTMEM_ADDR ((uintptr_t)e_emu_extmem)
+#else
 #define E_EXTMEM_ADDR 0x8e000000
+#endif
 #define E_COMBUF_ADDR (E_EXTMEM_ADDR + NEWLIB_SIZE)
 #define E_DYNMEM_ADDR (E_EXTMEM_ADDR + NEWLIB_SIZE + COMBUF_SIZE)
 
@@ -164,7 +243,7 @@ typedef struct {
 #define STATE_INIT 5
 #define STATE_EREADY 6
 #define STATE_ABORT 7
-#define STATE_MESSAGE 8
+#define STATE_PARKED 9
 
 // Clockspeed of Epiphany in cycles/second
 // This was 'measured' by comparing with ARM wall-time measurements
@@ -0,0 +1,94 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Stand-in for the e-hal header of the Epiphany SDK, used when the
+// library is built with `make emulator`. The emulated chip runs every
+// core as a thread in the host process, see src/emulator/e_hal.c
+
+#pragma once
+#include <stddef.h>
+#include <sys/types.h>
+
+#define E_OK 0
+#define E_ERR -1
+#define E_WARN -2
+
+typedef enum { E_FALSE = 0, E_TRUE = 1 } e_bool_t;
+
+typedef enum {
+    E_EPI_PLATFORM,
+    E_EPI_CHIP,
+    E_EPI_GROUP,
+    E_EPI_CORE,
+    E_EXT_MEM,
+} e_objtype_t;
+
+// The special core registers that the host reads
+typedef enum {
+    E_REG_PC = 0xf0408,
+} e_core_reg_id_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    unsigned row;
+    unsigned col;
+    unsigned rows;
+    unsigned cols;
+} e_platform_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    unsigned row;
+    unsigned col;
+    unsigned rows;
+    unsigned cols;
+    unsigned num_cores;
+} e_epiphany_t;
+
+typedef struct {
+    e_objtype_t objtype;
+    off_t phy_base;
+    size_t map_size;
+    void* base;     // host address of the buffer
+    off_t ephy_base; // epiphany address of the buffer
+    size_t emap_size;
+} e_mem_t;
+
+int e_init(char* hdf);
+int e_finalize();
+int e_reset_system();
+int e_get_platform_info(e_platform_t* platform);
+
+int e_open(e_epiphany_t* dev, unsigned row, unsigned col, unsigned rows,
+           unsigned cols);
+int e_close(e_epiphany_t* dev);
+int e_reset_group(e_epiphany_t* dev);
+int e_start_group(e_epiphany_t* dev);
+
+int e_alloc(e_mem_t* mbuf, off_t offset, size_t size);
+int e_free(e_mem_t* mbuf);
+
+// `dev` is either an e_epiphany_t or an e_mem_t, as in e-hal
+ssize_t e_read(void* dev, unsigned row, unsigned col, off_t from_addr,
+               void* buf, size_t size);
+ssize_t e_write(void* dev, unsigned row, unsigned col, off_t to_addr,
+                const void* buf, size_t size);
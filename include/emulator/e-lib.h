@@ -0,0 +1,145 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Stand-in for the e-lib header of the Epiphany SDK, used when the
+// library is built with `make emulator`. It only declares the parts of
+// e-lib that the BSP library and its tests use. Every core runs as a
+// thread on the host, see src/emulator/e_lib.c
+
+#pragma once
+#include <stdint.h>
+
+typedef enum { E_FALSE = 0, E_TRUE = 1 } e_bool_t;
+
+typedef unsigned short e_coreid_t;
+typedef char e_barrier_t;
+typedef int e_mutex_t;
+
+// Same layout as e_emu_group_config_t in src/emulator/e_emulator.h
+typedef struct {
+    unsigned group_rows;
+    unsigned group_cols;
+    unsigned core_row;
+    unsigned core_col;
+    unsigned group_row; // Absolute coordinates of core (0,0) of the group
+    unsigned group_col;
+} e_group_config_t;
+
+// Filled in by the emulated loader for every core
+extern e_group_config_t e_group_config;
+
+// Special core registers. The values are the addresses of the
+// memory-mapped registers as on the real chip
+typedef enum {
+    E_REG_CONFIG = 0xf0400,
+    E_REG_STATUS = 0xf0404,
+    E_REG_PC = 0xf0408,
+    E_REG_IMASK = 0xf0424,
+    E_REG_DMA1CONFIG = 0xf0520,
+    E_REG_DMA1STATUS = 0xf052c,
+} e_core_reg_id_t;
+
+unsigned e_reg_read(e_core_reg_id_t reg_id);
+void e_reg_write(e_core_reg_id_t reg_id, unsigned val);
+
+// Interrupts. There is no interrupt controller in the emulator so these
+// are only stored, never raised
+typedef enum {
+    E_SYNC = 0,
+    E_SW_EXCEPTION = 1,
+    E_MEM_FAULT = 2,
+    E_TIMER0_INT = 3,
+    E_TIMER1_INT = 4,
+    E_MESSAGE_INT = 5,
+    E_DMA0_INT = 6,
+    E_DMA1_INT = 7,
+    E_USER_INT = 9,
+} e_irq_type_t;
+
+void e_irq_attach(e_irq_type_t irq, void (*handler)());
+void e_irq_mask(e_irq_type_t irq, e_bool_t state);
+void e_irq_global_mask(e_bool_t state);
+
+// DMA
+typedef enum { E_DMA_0 = 0, E_DMA_1 = 1 } e_dma_id_t;
+
+#define E_DMA_ENABLE (1 << 0)
+#define E_DMA_MASTER (1 << 1)
+#define E_DMA_CHAIN (1 << 2)
+#define E_DMA_STARTUP (1 << 3)
+#define E_DMA_IRQEN (1 << 4)
+#define E_DMA_BYTE (0 << 5)
+#define E_DMA_HWORD (1 << 5)
+#define E_DMA_WORD (2 << 5)
+#define E_DMA_DWORD (3 << 5)
+#define E_DMA_MSGMODE (1 << 10)
+
+typedef struct {
+    unsigned config;
+    unsigned inner_stride;
+    unsigned count;
+    unsigned outer_stride;
+    void* src_addr;
+    void* dst_addr;
+} __attribute__((aligned(8))) e_dma_desc_t;
+
+// Queues the descriptor on the emulated DMA engine of this core.
+// E_DMA_ENABLE is cleared in the descriptor once the transfer is done
+int e_dma_start(e_dma_desc_t* descriptor, e_dma_id_t chan);
+
+// Cores and memory
+e_coreid_t e_get_coreid();
+e_coreid_t e_coreid_from_coords(unsigned row, unsigned col);
+void* e_get_global_address(unsigned row, unsigned col, const void* ptr);
+
+void e_barrier_init(volatile e_barrier_t bar_array[],
+                    volatile e_barrier_t* tgt_bar_array[]);
+void e_barrier(volatile e_barrier_t* bar_array,
+               volatile e_barrier_t* tgt_bar_array[]);
+
+void e_mutex_lock(unsigned row, unsigned col, e_mutex_t* mutex);
+void e_mutex_unlock(unsigned row, unsigned col, e_mutex_t* mutex);
+
+//
+// Emulator specific functions, not part of e-lib
+//
+
+// Size of the emulated local store of a core
+#define E_EMU_LOCAL_STORE_SIZE 0x8000
+
+// Part of the local store that holds code, globals and the stack on a real
+// core. The emulator keeps these elsewhere, but leaves this space unused so
+// that ebsp_malloc has roughly as much room as on the chip
+#define E_EMU_LOCAL_RESERVED 0x2000
+
+// The emulated DMA engine does not run in the background. Queued transfers
+// are carried out in order when the core waits for one of them, which is
+// the only moment at which a program may rely on the result anyway.
+void e_emu_dma_wait(e_dma_desc_t* descriptor);
+
+// Give up the CPU to the other cores and the host
+void e_emu_yield();
+
+extern char e_emu_local_store[E_EMU_LOCAL_STORE_SIZE];
+
+// Stop executing on this core, as a `trap` instruction would
+void e_emu_halt() __attribute__((noreturn));
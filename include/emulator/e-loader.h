@@ -0,0 +1,31 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Stand-in for the e-loader header of the Epiphany SDK, used when the
+// library is built with `make emulator`. An emulated `.elf` is a shared
+// object that is loaded once for every core, see src/emulator/e_hal.c
+
+#pragma once
+#include <e-hal.h>
+
+int e_load_group(char* executable, e_epiphany_t* dev, unsigned row,
+                 unsigned col, unsigned rows, unsigned cols, e_bool_t start);
@@ -56,6 +56,7 @@ see the files COPYING and COPYING.LESSER. If not, see
 
 #pragma once
 #include <e-hal.h>
+#include "e_bsp_datatypes.h"
 #include "host_bsp_deprecated.h"
 
 /**
@@ -129,15 +130,357 @@ void ebsp_set_sync_callback(void (*cb)());
  */
 void ebsp_set_end_callback(void (*cb)());
 
+/**
+ * The ways in which the host can poll the Epiphany cores during ebsp_spmd().
+ */
+typedef enum {
+    EBSP_POLL_INTERVAL, // Sleep a fixed interval between two polls
+    EBSP_POLL_SPIN,     // Poll continuously
+    EBSP_POLL_BACKOFF   // Spin for a while, then sleep increasingly longer
+} ebsp_poll_mode;
+
+/**
+ * Polling policy of the host, see ebsp_set_poll_policy().
+ */
+typedef struct {
+    ebsp_poll_mode mode;
+    int interval;    // Sleep time in microseconds for EBSP_POLL_INTERVAL,
+                     // maximum sleep time for EBSP_POLL_BACKOFF
+    int spin_count;  // Polls without activity before EBSP_POLL_BACKOFF sleeps
+    int cpu;         // CPU to run the polling thread on, or -1 for any CPU
+    int rt_priority; // SCHED_FIFO priority of the polling thread, or 0
+} ebsp_poll_policy;
+
+/**
+ * Set the way in which the host polls the Epiphany cores.
+ * @param policy A pointer to the new polling policy
+ * @return 1 on success, 0 on failure
+ *
+ * While ebsp_spmd() runs, the thread that called it polls the state of the
+ * Epiphany cores to handle ebsp_message(), ebsp_host_sync() and the end of
+ * the program. The policy determines the trade-off between the latency of
+ * these events and the CPU time used by the host.
+ *
+ * - `EBSP_POLL_INTERVAL` sleeps `interval` microseconds between polls.
+ * - `EBSP_POLL_SPIN` never sleeps, which keeps one ARM core busy.
+ * - `EBSP_POLL_BACKOFF` spins for `spin_count` polls after the last event
+ *   and then sleeps, starting at one microsecond and doubling up to
+ *   `interval` microseconds.
+ *
+ * When `cpu` is not -1 the polling thread is pinned to that CPU, and when
+ * `rt_priority` is nonzero it runs with real-time priority, which usually
+ * requires root privileges. Both are restored when ebsp_spmd() returns.
+ *
+ * The default policy is `EBSP_POLL_INTERVAL` with an interval of
+ * 1 microsecond. This function must be called after bsp_init().
+ */
+int ebsp_set_poll_policy(const ebsp_poll_policy* policy);
+
+/**
+ * What a core does with a message when its log ring is full.
+ */
+typedef enum {
+    EBSP_LOG_BLOCK, // Wait until the host has printed enough messages
+    EBSP_LOG_DROP   // Drop the message
+} ebsp_log_policy;
+
+/**
+ * Set what a core does when it writes messages faster than the host prints.
+ * @param policy The new policy
+ * @return 1 on success, 0 on failure
+ *
+ * Every core writes the output of ebsp_message() and bsp_abort() to its own
+ * ring buffer in external memory, without waiting for the host. The host
+ * prints the messages when it polls the cores. When the ring of a core is
+ * full, `EBSP_LOG_BLOCK` lets the core wait until the host has made room,
+ * and `EBSP_LOG_DROP` drops the message. The number of dropped messages is
+ * reported on stderr.
+ *
+ * The default policy is `EBSP_LOG_BLOCK`. This function must be called
+ * after bsp_init().
+ */
+int ebsp_set_log_policy(ebsp_log_policy policy);
+
+/**
+ * Set the size of the private part of external memory of every core.
+ * @param nbytes The size in bytes, or 0 for no private part
+ * @return 1 on success, 0 on failure
+ *
+ * The first call to ebsp_ext_malloc() on a core reserves an arena of
+ * `nbytes` bytes for that core. Further allocations that fit in the arena
+ * do not wait for the mutex that protects the shared memory, and do not
+ * read external memory. Memory in the arena is only reused after all
+ * allocations from it have been freed, so it suits temporary buffers that
+ * are freed together, for example at the end of a superstep. Allocations
+ * that do not fit use the shared memory as before. An arena with
+ * allocations that were not freed is kept for the next run of
+ * ebsp_next_run(). Its memory can only be freed by the core that
+ * allocated it, not by the host or by other cores.
+ *
+ * The default size is 0. This function must be called after bsp_init(),
+ * and takes effect at the next ebsp_spmd().
+ */
+int ebsp_set_ext_arena_size(unsigned int nbytes);
+
+/**
+ * Set the maximum number of variables that a core can register.
+ * @param count The number of variables, from 1 to 65535
+ * @return 1 on success, 0 on failure
+ *
+ * Every core keeps its table of registered variables in local memory,
+ * which takes about 7 bytes per variable. bsp_push_reg() fails when the
+ * table is full.
+ *
+ * The default is 20. This function must be called after bsp_init(), and
+ * takes effect at the next ebsp_spmd().
+ */
+int ebsp_set_max_bsp_vars(unsigned int count);
+
+/**
+ * Set the size of the buffer in local memory for bsp_put() on every core.
+ * @param nbytes The size of the buffer in bytes, at most 16 KB. 0 turns the
+ *  buffer off, which is the default
+ * @return 1 on success, 0 on failure
+ *
+ * Without this buffer, bsp_put() stores its request and payload in
+ * external memory, and bsp_sync() reads them back. With it, they stay in
+ * local memory, and bsp_sync() writes the payloads directly to the other
+ * cores. Every put takes 8 bytes of the buffer plus its payload, rounded
+ * up to a multiple of 8. When the buffer is full, the next puts of the
+ * superstep use external memory.
+ *
+ * This function must be called after bsp_init(), and takes effect at the
+ * next ebsp_spmd().
+ */
+int ebsp_set_put_buffer_size(unsigned int nbytes);
+
+/**
+ * Let the owner of the data write it for bsp_get() and ebsp_hpget_push().
+ * @param requests The number of requests that a core can forward to every
+ *  other core, at most 64. 0 turns this off, which is the default
+ * @return 1 on success, 0 on failure
+ *
+ * Writing to another core is much faster than reading from it. With this
+ * setting, bsp_get() and ebsp_hpget_push() send their request to an inbox
+ * in the local memory of the core that owns the data, which writes the
+ * data back. When the inbox is full, or without it, bsp_get() reads the
+ * data in bsp_sync() and ebsp_hpget_push() reads it at once.
+ *
+ * Every core keeps two inboxes, for bsp_get() and for ebsp_hpget_push().
+ * Together they take 512 bytes of local memory, plus 24 bytes per core and
+ * per request.
+ *
+ * This function must be called after bsp_init(), and takes effect at the
+ * next ebsp_spmd().
+ */
+int ebsp_set_get_inbox_size(unsigned int requests);
+
+/**
+ * Allocate external memory on the host.
+ * @param nbytes The size of the memory block
+ * @return A pointer to the allocated memory, or zero on error.
+ *
+ * The memory is shared with ebsp_ext_malloc() on the cores. The cores
+ * protect it with a mutex that the host can not take, so while the
+ * Epiphany program is running the host can only use it in the sync
+ * callback, when all cores wait in ebsp_host_sync(). At other moments
+ * during a run, the memory comes from the host heap of
+ * ebsp_set_host_heap_size().
+ */
+void* ebsp_ext_malloc(unsigned int nbytes);
+
+/**
+ * Free external memory on the host.
+ * @param ptr A pointer to memory previously allocated by ebsp_ext_malloc()
+ *
+ * This can be called at any time. Memory from the shared heap that is
+ * freed while the Epiphany program is running is released at the next
+ * sync or when the program finishes. Memory of the arena of a core, see
+ * ebsp_set_ext_arena_size(), can not be freed by the host.
+ */
+void ebsp_free(void* ptr);
+
+/**
+ * Set the size of the external memory that the host can allocate while
+ * the Epiphany program is running.
+ * @param nbytes The size in bytes, or 0 for no host heap
+ * @return 1 on success, 0 on failure
+ *
+ * The host heap is taken from the shared external memory at the next
+ * ebsp_spmd(), and kept until bsp_end(). With a host heap, the host can
+ * for example create new result buffers between calls to ebsp_spmd_poll().
+ * Memory of the host heap must only be freed by the host.
+ *
+ * The default size is 0. This function must be called after bsp_init(),
+ * and before the host heap is reserved.
+ */
+int ebsp_set_host_heap_size(unsigned int nbytes);
+
+/**
+ * Get the statistics of the local heap of a core.
+ * @param pid The processor id of the core
+ * @param stats Receives the statistics
+ * @return 1 on success, 0 on failure
+ *
+ * The statistics cover ebsp_malloc() and the memory that the library takes
+ * from it, such as stream buffers and scratch memory, during the last run
+ * of the program. `live_bytes` is the memory that was not freed at the end,
+ * `peak_bytes` is the most memory that was in use at any time, and
+ * `largest_free_run` is the largest block that was still available at the
+ * end. When the library is built with `MALLOC_SIZE_CLASSES`,
+ * `free_list_bytes` is the free memory that is kept for small blocks only.
+ * A core writes its statistics in bsp_end(), so this function should be
+ * called after ebsp_spmd().
+ */
+int ebsp_get_malloc_stats(int pid, ebsp_malloc_stats* stats);
+
+/**
+ * Get the statistics of the external memory heap.
+ * @param stats Receives the statistics
+ *
+ * The statistics cover ebsp_ext_malloc() on the host and on the cores of
+ * the current workgroup, since bsp_begin(). An arena of
+ * ebsp_set_ext_arena_size() counts as a single allocation. This function
+ * must not be called while the cores are running.
+ */
+void ebsp_get_ext_malloc_stats(ebsp_malloc_stats* stats);
+
+/**
+ * Events in the sync timeline, see ebsp_timeline_enable().
+ */
+typedef enum {
+    EBSP_TIMELINE_SYNC,     // A core called ebsp_host_sync()
+    EBSP_TIMELINE_CALLBACK, // The host starts the sync callback
+    EBSP_TIMELINE_RELEASE,  // The host lets the cores continue
+    EBSP_TIMELINE_FINISH    // A core called bsp_end()
+} ebsp_timeline_event;
+
+/**
+ * A single event in the sync timeline.
+ */
+typedef struct {
+    ebsp_timeline_event event;
+    int superstep; // Number of host syncs before this event
+    int pid;       // The core, or -1 for events of the host
+    double time;   // Seconds since the start of ebsp_spmd()
+} ebsp_timeline_record;
+
+/**
+ * Output formats of ebsp_timeline_dump().
+ */
+typedef enum {
+    EBSP_TIMELINE_CSV,   // One line per record
+    EBSP_TIMELINE_CHROME // Trace for chrome://tracing or Perfetto
+} ebsp_timeline_format;
+
+/**
+ * Record a timeline of the host syncs in ebsp_spmd().
+ * @param capacity The maximum number of records that are kept,
+ * or 0 to stop recording
+ * @return 1 on success, 0 on failure
+ *
+ * The host records the moment at which every core enters ebsp_host_sync()
+ * or bsp_end(), and the moments at which the host calls the sync callback
+ * and releases the cores. The timestamps have the precision of the polling
+ * interval, see ebsp_set_poll_policy().
+ *
+ * The records are stored in a ring buffer that is allocated by this
+ * function, so recording does not allocate memory while the cores run.
+ * When more than `capacity` events occur, the oldest records are dropped.
+ * Every call to ebsp_spmd() starts a new timeline.
+ *
+ * This function must be called after bsp_init(). The records remain
+ * available until bsp_end().
+ */
+int ebsp_timeline_enable(int capacity);
+
+/**
+ * Copy the records of the sync timeline.
+ * @param records A buffer receiving the records, oldest first
+ * @param max_records The size of the buffer
+ * @return The number of records that were copied
+ */
+int ebsp_timeline_records(ebsp_timeline_record* records, int max_records);
+
+/**
+ * Write the sync timeline to a file.
+ * @param filename The file to write to
+ * @param format The output format
+ * @return 1 on success, 0 on failure
+ *
+ * The CSV format has a line `superstep,pid,event,time_us` for every record.
+ *
+ * The Chrome trace format shows every core as a thread. A core is
+ * `computing` from the previous release until it calls ebsp_host_sync(), and
+ * `waiting` from then until the next release. The host thread shows the
+ * time spent in the sync callback.
+ */
+int ebsp_timeline_dump(const char* filename, ebsp_timeline_format format);
+
 /**
  * Runs the Epiphany program on the Epiphany cores.
  * @return 1 on success, 0 on failure (e.g. after `bsp_abort` is called on a
  * core)
  *
  * This function will block until the BSP kernel program is finished.
+ *
+ * When the Epiphany program calls ebsp_next_run() after bsp_end(), this
+ * function can be called again to run the program again without loading it.
  */
 int ebsp_spmd();
 
+/**
+ * Start the Epiphany program without waiting for it to finish.
+ * @return 1 on success, 0 on failure
+ *
+ * This is the first half of ebsp_spmd(), for host programs that want to do
+ * other work while the Epiphany cores run. The host must then call
+ * ebsp_spmd_poll() regularly, or ebsp_spmd_wait() to block until the program
+ * is finished.
+ *
+ * The cores only make progress past ebsp_host_sync() and ebsp_message() when
+ * the host polls them: while no poll happens, a core that sends a message
+ * and the cores in a host sync wait for the host.
+ *
+ * Usage example:
+ * \code{.c}
+ * ebsp_spmd_start();
+ * while (ebsp_spmd_poll()) {
+ *     prepare_next_batch();
+ * }
+ * ebsp_spmd_wait(); // Get the result
+ * \endcode
+ */
+int ebsp_spmd_start();
+
+/**
+ * Handle the events of the running Epiphany program, without blocking.
+ * @return 1 if the program is still running, 0 if it has finished
+ *
+ * A single call handles everything the cores are waiting for:
+ * - Messages sent with ebsp_message() are printed to stdout, in the
+ *   thread that calls this function.
+ * - When all cores are in ebsp_host_sync(), the sync callback is called
+ *   from within this function, after which the cores continue.
+ * - When all cores have finished, the final state is read and the end
+ *   callback is called. Messages sent with ebsp_send_up() can be read
+ *   after this call returns 0.
+ *
+ * Only one thread at a time can call this function.
+ */
+int ebsp_spmd_poll();
+
+/**
+ * Wait for the Epiphany program started with ebsp_spmd_start() to finish.
+ * @return 1 on success, 0 on failure (e.g. after `bsp_abort` is called on a
+ * core)
+ *
+ * This function polls the cores with the policy set by
+ * ebsp_set_poll_policy() until the program is finished. When
+ * ebsp_spmd_poll() already returned 0, it returns the result immediately.
+ */
+int ebsp_spmd_wait();
+
 /**
  * Loads the BSP program onto the Epiphany cores.
  * @param nprocs The number of processors to run on
@@ -159,6 +502,66 @@ int ebsp_spmd();
  */
 int bsp_begin(int nprocs);
 
+/**
+ * Load a BSP program onto a rectangle of Epiphany cores.
+ * @param e_name The name of the Epiphany program, as for bsp_init()
+ * @param row The first row of the rectangle
+ * @param col The first column of the rectangle
+ * @param rows The number of rows
+ * @param cols The number of columns
+ * @return The id of the new workgroup, or -1 on failure
+ *
+ * This is the alternative to bsp_begin() for running several independent
+ * programs at the same time. Every workgroup has its own program,
+ * `rows * cols` processors, barrier, message queues, streams and
+ * external memory for ebsp_ext_malloc(). The rectangles may not overlap.
+ *
+ * The functions of the host act on the selected workgroup, see
+ * ebsp_group_select(), so for example ebsp_spmd_start() starts its program
+ * and bsp_nprocs() returns its number of processors. bsp_end() ends all
+ * workgroups.
+ *
+ * Every workgroup gets a part of the external memory for its communication
+ * buffer and for ebsp_ext_malloc(): one communication buffer, and the same
+ * share of ebsp_ext_malloc() memory for each of its cores. The external
+ * memory holds four communication buffers plus the shares of all cores,
+ * so four workgroups always fit. A core that no workgroup uses only frees
+ * its share, which is about half a communication buffer, so for example
+ * 16 workgroups of one core do not fit. Memory that the host allocates
+ * with ebsp_ext_malloc() before this call leaves less room.
+ *
+ * Usage example:
+ * \code{.c}
+ * bsp_init("e_program.elf", argc, argv);
+ * int a = ebsp_group_begin("e_first.elf", 0, 0, 2, 4);
+ * int b = ebsp_group_begin("e_second.elf", 2, 0, 2, 4);
+ * for (int g = a; g <= b; g++) {
+ *     ebsp_group_select(g);
+ *     ebsp_spmd_start();
+ * }
+ * for (int g = a; g <= b; g++) {
+ *     ebsp_group_select(g);
+ *     ebsp_spmd_wait();
+ * }
+ * bsp_end();
+ * \endcode
+ *
+ * @remarks ebsp_group_begin() also selects the new workgroup, so the
+ * functions of the host that are called afterwards, such as
+ * ebsp_set_tagsize() and ebsp_send_down(), act on the new workgroup until
+ * another one is selected with ebsp_group_select(). When it fails, the
+ * selected workgroup does not change.
+ */
+int ebsp_group_begin(const char* e_name, int row, int col, int rows,
+                     int cols);
+
+/**
+ * Select the workgroup that the functions of the host act on.
+ * @param group A workgroup id returned by ebsp_group_begin()
+ * @return 1 on success, 0 on failure
+ */
+int ebsp_group_select(int group);
+
 /**
  * Finalizes and cleans up the BSP program.
  * @return 1 on success, 0 on failure
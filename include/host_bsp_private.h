@@ -25,12 +25,27 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include "host_bsp.h"
 #include "ebsp_common.h"
 
+#ifndef __USE_XOPEN2K
 #define __USE_XOPEN2K
+#endif
 #define __USE_POSIX199309 1
 #include <time.h>
 
 #define MAX_N_STREAMS 1000
 
+// ebsp_host_time on the cores is only updated when the time of the host has
+// advanced this many seconds, so that polling without sleeping does not
+// write to external memory in every iteration
+#define REMOTE_TIMER_RESOLUTION 5.0e-6f
+
+// Part of ebsp_combuf that is copied to the cores in ebsp_spmd
+#define COMBUF_HEADER_SIZE (offsetof(ebsp_combuf, data_requests))
+
+// External memory for ebsp_ext_malloc of a workgroup of ebsp_group_begin,
+// which also needs COMBUF_SIZE for its combuf. This leaves room for the
+// combufs of four workgroups
+#define GROUP_DYNMEM_PER_CORE ((DYNMEM_SIZE - 5 * COMBUF_SIZE) / NPROCS)
+
 #ifdef DEBUG
 typedef struct {
     int index;
@@ -43,11 +58,24 @@ typedef struct {
 } Symbol;
 #endif
 
+// Format strings of ebsp_message_deferred that were read from the cores,
+// indexed by their address
+#define LOG_FORMAT_CACHE 32
+
+typedef struct {
+    uintptr_t address; // 0 for an empty entry
+    char text[LOG_MESSAGE_SIZE];
+} ebsp_log_format;
+
 /*
  *  Global BSP state
  */
 
 typedef struct {
+    // 1 after bsp_init, 2 after bsp_begin or when preparing a rerun,
+    // 3 after ebsp_spmd, 4 while the program runs, 0 after bsp_end
+    int initialized;
+
     // The number of processors available
     int nprocs;
 
@@ -69,10 +97,13 @@ typedef struct {
 
     // memory-mapped pointers to external memory
     // They are the host-side version of E_XXX_ADDR in common.h
-    void* host_combuf_addr;
+    ebsp_combuf* host_combuf_addr;
     void* host_dynmem_addr;
+    unsigned dynmem_size;
 
-    // Local copy of ebsp_combuf to copy from and copy into.
+    // Local copy of the first COMBUF_HEADER_SIZE bytes of ebsp_combuf,
+    // which contain the sync states and the settings for the cores.
+    // The message queue and payloads are used in host_combuf_addr directly
     ebsp_combuf combuf;
     // For reading out the final queue after spmd
     int message_index;
@@ -80,6 +111,51 @@ typedef struct {
     void (*sync_callback)(void);
     void (*end_callback)(void);
 
+    ebsp_poll_policy poll_policy;
+
+    // See ebsp_set_log_policy
+    ebsp_log_policy log_policy;
+
+    // See ebsp_set_ext_arena_size
+    unsigned int ext_arena_size;
+
+    // See ebsp_set_max_bsp_vars, 0 for MAX_BSP_VARS
+    unsigned int max_bsp_vars;
+
+    // See ebsp_set_put_buffer_size
+    unsigned int put_buffer_size;
+
+    // See ebsp_set_get_inbox_size
+    unsigned int get_inbox_size;
+
+    // Heap for ebsp_ext_malloc on the host while the cores run, taken from
+    // the shared heap at the first ebsp_spmd, see ebsp_set_host_heap_size
+    unsigned int host_heap_size;
+    void* host_heap;
+    // 1 while all cores wait in ebsp_host_sync, so that the host can use
+    // the shared heap
+    int cores_waiting;
+    // Shared memory that the host freed while the cores run. It is released
+    // at the next sync or when the program finishes
+    void** deferred_frees;
+    int deferred_free_count;
+    int deferred_free_capacity;
+    uint32_t log_dropped[NPROCS]; // Dropped messages that were reported
+    ebsp_log_format log_formats[LOG_FORMAT_CACHE];
+
+    // Progress of the running program, see ebsp_spmd_poll
+    int total_syncs;
+    int extmem_corrupted;
+    int poll_busy; // 1 if the last poll handled an event
+    int spmd_result;
+    int rerun; // 1 when the next run releases the cores from ebsp_next_run
+
+    // Ring buffer with the sync timeline
+    ebsp_timeline_record* timeline;
+    int timeline_capacity;
+    int timeline_count; // Total number of records, including dropped ones
+    int8_t timeline_syncstate[NPROCS]; // Last syncstate seen of every core
+
     int num_vars_registered;
 
     // Epiphany specific variables
@@ -88,6 +164,7 @@ typedef struct {
 
     // Timer storage
     struct timespec ts_start, ts_end;
+    float remote_time; // Last value written to remotetimer
 
     // Buffer. First is deprecated, second is new version
     ebsp_stream_descriptor buffered_streams[NPROCS][MAX_N_STREAMS];
@@ -101,7 +178,8 @@ typedef struct {
 
 } bsp_state_t;
 
-extern bsp_state_t state;
+extern bsp_state_t main_state;
+extern bsp_state_t* state;
 
 /*
  *  host_bsp
@@ -109,19 +187,39 @@ extern bsp_state_t state;
 int bsp_init(const char* _e_name, int argc, char** argv);
 int bsp_begin(int nprocs);
 int ebsp_spmd();
+int ebsp_spmd_start();
+int ebsp_spmd_poll();
+int ebsp_spmd_wait();
+int _prepare_rerun();
+void _reset_message_queues();
 int bsp_end();
 int bsp_nprocs();
 
+/*
+ *  host_bsp_group
+ */
+int ebsp_group_begin(const char* e_name, int row, int col, int rows,
+                     int cols);
+int ebsp_group_select(int group);
+int _groups_end();
+
 /*
  *  host_bsp_memory
  */
 void ebsp_malloc_init();
 void* ebsp_ext_malloc(unsigned int nbytes);
 void ebsp_free(void* ptr);
+int ebsp_set_ext_arena_size(unsigned int nbytes);
+int ebsp_set_host_heap_size(unsigned int nbytes);
+int ebsp_set_max_bsp_vars(unsigned int count);
+int ebsp_set_put_buffer_size(unsigned int nbytes);
 int ebsp_write(int pid, void* src, off_t dst, int size);
 int ebsp_read(int pid, off_t src, void* dst, int size);
 int _write_core_syncstate(int pid, int syncstate);
 int _write_extmem(void* src, off_t offset, int size);
+int _read_extmem(void* dst, off_t offset, int size);
+int _reserve_host_heap();
+void _release_deferred_frees();
 
 /*
  *  host_bsp_buffer
@@ -161,6 +259,33 @@ void _microsleep(int microseconds);
 void _get_p_coords(int pid, int* row, int* col);
 void init_application_path();
 
+/*
+ *  host_bsp_poll
+ */
+int ebsp_set_poll_policy(const ebsp_poll_policy* policy);
+void _poll_set_default();
+void _poll_begin();
+void _poll_wait(int busy);
+void _poll_end();
+
+/*
+ *  host_bsp_log
+ */
+int ebsp_set_log_policy(ebsp_log_policy policy);
+void _log_reset();
+int _log_drain(int flush);
+void _log_end();
+
+/*
+ *  host_bsp_timeline
+ */
+int ebsp_timeline_enable(int capacity);
+int ebsp_timeline_records(ebsp_timeline_record* records, int max_records);
+int ebsp_timeline_dump(const char* filename, ebsp_timeline_format format);
+void _timeline_begin();
+void _timeline_update(int superstep);
+void _timeline_record(ebsp_timeline_event event, int superstep, int pid);
+
 /*
  * host_bsp_debug
  */
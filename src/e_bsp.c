@@ -22,12 +22,11 @@ see the files COPYING and COPYING.LESSER. If not, see
 
 #include "e_bsp_private.h"
 #include <string.h>
-#include <stdio.h>
 #include <stdarg.h>
 
 ebsp_core_data coredata;
 
-void _write_syncstate(int8_t state);
+void _log_next_epoch();
 
 void _int_isr();
 void _dma_interrupt();
@@ -40,6 +39,15 @@ void EXT_MEM_TEXT bsp_begin() {
 
     // Since coredata is in the .bss section it will automatically be filled
     // with zeroes so no need to do that here. Only fill the nonzero elements
+    // Cores in a workgroup of ebsp_group_begin find their combuf
+    // in the list of workgroups, the others use the default one
+    ebsp_combuf* main_combuf = (ebsp_combuf*)E_COMBUF_ADDR;
+    uint16_t coreid = (uint16_t)e_get_coreid();
+    coredata.combuf_addr = main_combuf;
+    for (int i = 0; i < NPROCS && main_combuf->group_coreid[i] != 0; i++)
+        if (main_combuf->group_coreid[i] == coreid)
+            coredata.combuf_addr = main_combuf->group_combuf[i];
+
     coredata.pid = col + cols * row;
     coredata.nprocs = combuf->nprocs;
     coredata.tagsize = combuf->tagsize;
@@ -56,13 +64,17 @@ void EXT_MEM_TEXT bsp_begin() {
             coredata.coreids[s++] = (uint16_t)e_coreid_from_coords(i, j);
 
     // Initialize the barrier and mutexes
-    e_barrier_init(coredata.sync_barrier, coredata.sync_barrier_tgt);
-
-    // Barrier fix:
-    // if core i is at ebsp_barrier but core j has not even done bsp_begin yet
-    // then behaviour was undefined. The following line should fix this
-    // by setting core0.sync_barrier[i] = 0
-    *(coredata.sync_barrier_tgt[0]) = 0;
+    // The barrier is kept by ebsp_next_run, because cores that are not
+    // used still take part in it
+    if (coredata.sync_barrier_tgt[0] == 0) {
+        e_barrier_init(coredata.sync_barrier, coredata.sync_barrier_tgt);
+
+        // Barrier fix:
+        // if core i is at ebsp_barrier but core j has not even done bsp_begin
+        // yet then behaviour was undefined. The following line should fix
+        // this by setting core0.sync_barrier[i] = 0
+        *(coredata.sync_barrier_tgt[0]) = 0;
+    }
 
     // Disable interrupts globally
     e_irq_global_mask(E_TRUE);
@@ -90,6 +102,9 @@ void EXT_MEM_TEXT bsp_begin() {
     e_irq_global_mask(E_FALSE);
 
     _init_local_malloc();
+    _init_var_list();
+    _init_get_inbox();
+    _init_put_buffer();
 
     // Copy stream descriptors to local memory
     // TODO: do this only when the stream is opened
@@ -109,6 +124,7 @@ void EXT_MEM_TEXT bsp_begin() {
     // Wait for ARM before starting
     _write_syncstate(STATE_EREADY);
     while (coredata.syncstate != STATE_CONTINUE) {
+        SPIN_WAIT();
     }
 #endif
     _write_syncstate(STATE_RUN);
@@ -121,19 +137,42 @@ void EXT_MEM_TEXT bsp_begin() {
 
     // If this core is not supposed to be used, make sure the workgroup barrier
     // works.
-    // TODO for future release: write a simpler own version of e_barrier
-    // that works without the full workgroup, allowing multiple instances
-    // to run on the same epiphany chips instead of having these spinning
-    // unused cores
+    // Use ebsp_group_begin on the host to make a workgroup of only the
+    // cores that are needed, so that other programs can use the rest
     if (coredata.pid >= coredata.nprocs)
         for (;;)
             e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
 }
 
 void bsp_end() {
+    _release_ext_arena();
+    _write_malloc_stats();
     _write_syncstate(STATE_FINISH);
 }
 
+int EXT_MEM_TEXT ebsp_next_run() {
+    // Reset coredata to the state in which the loader left it,
+    // except for the barrier, the mutexes and the ext arena. Other cores
+    // may still be running, and the mutexes of core 0 are held by all
+    // cores. Every critical section unlocks its mutex, so they are free
+    // when all cores are parked
+    int32_t pid = coredata.pid;
+    ebsp_combuf* cb = coredata.combuf_addr;
+    memset((void*)&coredata, 0, offsetof(ebsp_core_data, sync_barrier));
+    memset((void*)&coredata.local_malloc_base, 0,
+           sizeof(ebsp_core_data) -
+               offsetof(ebsp_core_data, local_malloc_base));
+    coredata.pid = pid;
+    coredata.combuf_addr = cb;
+
+    // Wait for the host to start the next run or to end the program
+    _write_syncstate(STATE_PARKED);
+    while (coredata.syncstate == STATE_PARKED) {
+        SPIN_WAIT();
+    }
+    return coredata.syncstate == STATE_CONTINUE;
+}
+
 int bsp_nprocs() { return coredata.nprocs; }
 
 int bsp_pid() { return coredata.pid; }
@@ -152,15 +191,34 @@ void bsp_sync() {
 
     // Instead of copying the code twice, we put it in a loop
     // so that the code is shorter (this is tested)
+    // Most gets were forwarded to the owner of the data, which writes it to
+    // the requesting core, so that no core has to read remote memory
     ebsp_data_request* reqs = &combuf->data_requests[coredata.pid][0];
     for (int put = 0;;) {
         e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
+        if (put == 0)
+            _serve_gets(1);
+        else
+            _flush_put_buffer();
         for (int i = 0; i < coredata.request_counter; ++i) {
-            int nbytes = reqs[i].nbytes;
+            ebsp_data_request* req = &reqs[i];
+            int nbytes = req->nbytes;
+            ebsp_data_strides* strides = 0;
+            if (nbytes & DATA_STRIDED_BIT)
+                strides = (ebsp_data_strides*)&reqs[++i];
             // Check if this is a get or a put
-            if ((nbytes & DATA_PUT_BIT) == put)
-                ebsp_memcpy(reqs[i].dst, reqs[i].src, nbytes & ~DATA_PUT_BIT);
+            if ((nbytes & DATA_PUT_BIT) != put)
+                continue;
+            nbytes &= ~(DATA_PUT_BIT | DATA_STRIDED_BIT);
+            if (strides)
+                _sync_copy_strided(req->dst, req->src, nbytes, strides->count,
+                                   strides->dst_stride, strides->src_stride);
+            else
+                _sync_copy(req->dst, req->src, nbytes);
         }
+        // The gets must be finished before the puts, which can overwrite
+        // the same data, and the puts before the last barrier
+        _sync_copy_wait();
         if (put == 0)
             put = DATA_PUT_BIT;
         else
@@ -173,6 +231,7 @@ void bsp_sync() {
     // so all cores are syncing) and only one core needs to set this, but
     // letting all cores set it produces smaller code (binary size)
     combuf->data_payloads.buffer_size = 0;
+    coredata.payload_chunk_size = 0;
     combuf->message_queue[coredata.read_queue_index].count = 0;
     // Switch queue between 0 and 1
     // xor seems to produce the shortest assembly
@@ -182,15 +241,21 @@ void bsp_sync() {
     coredata.message_index = 0;
 
     e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
+    _update_var_cache();
+    _log_next_epoch();
 }
 
 void ebsp_barrier() {
+    _serve_gets(0);
+    _sync_copy_wait();
     e_barrier(coredata.sync_barrier, coredata.sync_barrier_tgt);
+    _log_next_epoch();
 }
 
 void ebsp_host_sync() {
     _write_syncstate(STATE_SYNC);
     while (coredata.syncstate != STATE_CONTINUE) {
+        SPIN_WAIT();
     }
     _write_syncstate(STATE_RUN);
 }
@@ -200,82 +265,153 @@ void _write_syncstate(int8_t state) {
     combuf->syncstate[coredata.pid] = state; // being polled by ARM
 }
 
-void __attribute__((interrupt)) _int_isr() {
+void INTERRUPT_HANDLER _int_isr() {
+#ifndef EBSP_EMULATOR
     __asm__(
         "movfs r0, ipend"); // moves IPEND into r0 which is the first argument
 
     register int ipend_copy __asm__("r0");
     combuf->interrupts[coredata.pid] = ipend_copy;
+#endif
 
     return;
 }
 
-// Assumes the mutex `ebsp_message_mutex` is locked
-void EXT_MEM_TEXT ebsp_send_string(const char* string) {
-    // Write the message
-    ebsp_memcpy(&combuf->msgbuf[0], string, sizeof(combuf->msgbuf));
+// Append a record to the log ring of this core. The host prints it
+// the next time it polls, so the core does not wait for the host
+// unless the ring is full. Only this append is in local memory, the
+// formatting and the scanning of the arguments are in external memory
+void _log_write(const void* data, int length, uint32_t flags) {
+    ebsp_log_ring* ring = &combuf->log[coredata.pid];
+    uint32_t size = (sizeof(ebsp_log_header) + length + 7) & ~7;
+
+    if (coredata.log_head + size - coredata.log_tail > LOG_RING_SIZE) {
+        coredata.log_tail = *(volatile uint32_t*)&ring->tail;
+        while (coredata.log_head + size - coredata.log_tail > LOG_RING_SIZE) {
+            if (combuf->log_drop) {
+                ring->dropped = ++coredata.log_dropped;
+                return;
+            }
+            SPIN_WAIT();
+            coredata.log_tail = *(volatile uint32_t*)&ring->tail;
+        }
+    }
 
-    // Wait for message to be written
-    _write_syncstate(STATE_MESSAGE);
-    while (coredata.syncstate != STATE_CONTINUE) {
-    };
-    _write_syncstate(STATE_RUN);
+    // Records start at a multiple of 8 bytes, so only the data can wrap
+    uint32_t offset = coredata.log_head % LOG_RING_SIZE;
+    ebsp_log_header header = {coredata.log_epoch, length | flags};
+    ebsp_memcpy(&ring->buf[offset], &header, sizeof(header));
+    offset = (offset + sizeof(header)) % LOG_RING_SIZE;
+    uint32_t first = LOG_RING_SIZE - offset;
+    if (first > (uint32_t)length)
+        first = length;
+    ebsp_memcpy(&ring->buf[offset], data, first);
+    ebsp_memcpy(&ring->buf[0], (const char*)data + first, length - first);
+
+    coredata.log_head += size;
+    WRITE_FENCE();
+    ring->head = coredata.log_head;
 }
 
-void EXT_MEM_TEXT bsp_abort(const char* format, ...) {
-    // Because of the way these arguments work we can not
-    // simply call ebsp_message here
-    // so this function contains a copy of ebsp_message
-
-    // Lock mutex
-    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
-    // Write the message to a buffer
-    char buf[128];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(&buf[0], sizeof(buf), format, args);
-    va_end(args);
-    ebsp_send_string(buf);
-    // Unlock mutex
-    e_mutex_unlock(0, 0, &coredata.ebsp_message_mutex);
-
-    // Abort all cores and notify host
-    _write_syncstate(STATE_ABORT);
-    // Experimental Epiphany feature that sends
-    // and abort signal to all cores
-    __asm__("MBKPT");
-    // Halt this core
-    __asm__("trap 3");
+// Let the host know that the messages before the barrier are complete,
+// see _log_drain on the host
+void _log_next_epoch() {
+    combuf->log[coredata.pid].epoch = ++coredata.log_epoch;
 }
 
-void EXT_MEM_TEXT ebsp_message(const char* format, ...) {
-    // If format contains a %f then the printf family
-    // calls the function `cvt` which calls `dtoi_r`.
-    // `dtoi_r` calls Balloc (a private malloc used only
-    // within `dtoi_r`) which calls `calloc_r`
-    // which then calls `malloc_r`.
-    // The r means that the functions are reentrant.
-    // However `malloc_r` is not thread safe
-    // (where threads means cores in this case)
-    // and there will be crashes when multiple cores
-    // call it at the same time.
-    // Therefore, this printf is wrapped in a mutex
-    // even though at first hand it looks like it is
-    // not altering any global state.
-
-    // Lock mutex
-    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
-
-    // Write the message to a buffer
-    char buf[128];
+// Store the next argument of type `type` in the record, at a multiple of
+// its size. _log_format on the host reads the arguments in the same way
+#define LOG_ARG(type)                                                          \
+    {                                                                          \
+        size = (size + sizeof(type) - 1) & ~(sizeof(type) - 1);                \
+        if (size + sizeof(type) > LOG_MESSAGE_SIZE)                            \
+            goto full;                                                         \
+        *(type*)&data[size] = va_arg(args, type);                              \
+        size += sizeof(type);                                                  \
+    }
+
+void EXT_MEM_TEXT ebsp_message_deferred(const char* format, ...) {
+    // The record holds the address of the format string and the raw
+    // arguments. The format string is only scanned for the argument types
+    uint64_t record[LOG_MESSAGE_SIZE / sizeof(uint64_t)];
+    char* data = (char*)record;
+    uint32_t size = sizeof(const char*);
+    *(const char**)data = format;
+
     va_list args;
     va_start(args, format);
-    vsnprintf(&buf[0], sizeof(buf), format, args);
-    va_end(args);
+    for (const char* f = format; *f; f++) {
+        if (*f != '%')
+            continue;
+
+        // Flags, width, precision and length modifiers
+        int longs = 0;
+        int sized = 0;
+        for (f++;; f++) {
+            char c = *f;
+            if (c == '*')
+                LOG_ARG(int)
+            else if (c == 'l')
+                longs++;
+            else if (c == 'j')
+                longs = 2;
+            else if (c == 'z' || c == 't')
+                sized = 1;
+            else if (!((c >= '0' && c <= '9') || c == '-' || c == '+' ||
+                       c == ' ' || c == '#' || c == '.' || c == 'h' ||
+                       c == 'L'))
+                break;
+        }
 
-    ebsp_send_string(buf);
+        switch (*f) {
+        case 0:
+            goto full;
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (longs >= 2)
+                LOG_ARG(long long)
+            else if (longs == 1)
+                LOG_ARG(long)
+            else if (sized)
+                LOG_ARG(size_t)
+            else
+                LOG_ARG(int)
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            LOG_ARG(double)
+            break;
+        case 'p':
+        case 'n':
+            LOG_ARG(void*)
+            break;
+        case 's': {
+            // Strings are copied, the host can not read them afterwards
+            if (size >= LOG_MESSAGE_SIZE)
+                goto full;
+            const char* s = va_arg(args, const char*);
+            while (*s && size < LOG_MESSAGE_SIZE - 1)
+                data[size++] = *s++;
+            data[size++] = 0;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+full:
+    va_end(args);
 
-    // Unlock mutex
-    e_mutex_unlock(0, 0, &coredata.ebsp_message_mutex);
+    _log_write(data, size, LOG_DEFERRED_BIT);
 }
-
@@ -51,13 +51,14 @@ void _ebsp_read_chunk(ebsp_stream* stream, void* target) {
         void* src = stream->cursor + 2 * sizeof(int);
 
         // jump over header+chunk
-        stream->cursor = (void*)(((unsigned)(stream->cursor)) +
+        stream->cursor = (void*)(((uintptr_t)(stream->cursor)) +
                                  2 * sizeof(int) + chunk_size);
 
         // If token is too large, truncate it.
         // However DO jump the correct distance with cursor
         if (chunk_size > stream->max_chunksize) {
-            ebsp_message(err_token_size, chunk_size, stream->max_chunksize);
+            ebsp_message_deferred(err_token_size, chunk_size,
+                                  stream->max_chunksize);
             chunk_size = stream->max_chunksize;
         }
 
@@ -86,7 +87,7 @@ void _ebsp_read_chunk(ebsp_stream* stream, void* target) {
 
 int bsp_stream_open(ebsp_stream* stream, int stream_id) {
     if (stream_id >= combuf->nstreams) {
-        ebsp_message(err_no_such_stream2);
+        ebsp_message_deferred(err_no_such_stream2);
         return 0;
     }
     ebsp_stream_descriptor* s = &(combuf->streams[stream_id]);
@@ -101,7 +102,7 @@ int bsp_stream_open(ebsp_stream* stream, int stream_id) {
     e_mutex_unlock(0, 0, &coredata.stream_mutex);
 
     if (mypid != -1) {
-        ebsp_message(err_stream_in_use, stream_id);
+        ebsp_message_deferred(err_stream_in_use, stream_id);
         return 0;
     }
 
@@ -177,7 +178,7 @@ int bsp_stream_move_down(ebsp_stream* stream, void** buffer, int preload) {
         stream->current_buffer =
             ebsp_malloc(stream->max_chunksize + 2 * sizeof(int));
         if (stream->current_buffer == NULL) {
-            ebsp_message(err_out_of_memory2);
+            ebsp_message_deferred(err_out_of_memory2);
             return 0;
         }
     }
@@ -211,7 +212,7 @@ int bsp_stream_move_down(ebsp_stream* stream, void** buffer, int preload) {
     //  which we should now give to the user.
 
     // *buffer must point after the header
-    (*buffer) = (void*)((unsigned)stream->current_buffer + 2 * sizeof(int));
+    (*buffer) = (void*)((uintptr_t)stream->current_buffer + 2 * sizeof(int));
 
     int* header = (int*)(stream->current_buffer);
     int current_chunk_size = header[1];
@@ -225,10 +226,13 @@ int bsp_stream_move_down(ebsp_stream* stream, void** buffer, int preload) {
     if (preload) {
         if (stream->next_buffer == NULL) {
             // no next buffer available, malloc it
+            // in another bank, so that the DMA does not stall the reads
+            // of current_buffer
             stream->next_buffer =
-                ebsp_malloc(stream->max_chunksize + 2 * sizeof(int));
+                _malloc_apart(stream->max_chunksize + 2 * sizeof(int),
+                              stream->current_buffer);
             if (stream->next_buffer == NULL) {
-                ebsp_message(err_out_of_memory2);
+                ebsp_message_deferred(err_out_of_memory2);
                 return 0;
             }
         }
@@ -258,8 +262,8 @@ int bsp_stream_move_up(ebsp_stream* stream, const void* data, int data_size,
     data_size = ((data_size + 8 - 1) / 8) * 8;
 
     if (data_size > stream->max_chunksize) {
-        ebsp_message(err_up_size_warning, data_size, stream->id,
-                     stream->max_chunksize);
+        ebsp_message_deferred(err_up_size_warning, data_size, stream->id,
+                              stream->max_chunksize);
     }
 
     // Check if there is enough space in the stream,
@@ -267,9 +271,10 @@ int bsp_stream_move_up(ebsp_stream* stream, const void* data, int data_size,
     // Be carefull to use unsigned here, since these addresses
     // are over the INT_MAX boundary.
     unsigned space_required = (unsigned)data_size + 4 * sizeof(int);
-    unsigned space_left = (unsigned)stream->extmem_end - (unsigned)stream->cursor;
+    unsigned space_left = (uintptr_t)stream->extmem_end - (uintptr_t)stream->cursor;
     if (space_left < space_required) {
-        ebsp_message(err_stream_full, stream->id, space_left, space_required);
+        ebsp_message_deferred(err_stream_full, stream->id, space_left,
+                              space_required);
         return 0;
     }
 
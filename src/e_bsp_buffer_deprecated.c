@@ -56,29 +56,29 @@ void ebsp_set_up_chunk_size(unsigned stream_id, int nbytes) {
 
 int ebsp_open_up_stream(void** address, unsigned stream_id) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return 0;
     }
 
     ebsp_stream_descriptor* stream = &coredata.local_streams[stream_id];
 
     if (stream->is_down_stream) {
-        ebsp_message(err_mixed_up_down);
+        ebsp_message_deferred(err_mixed_up_down);
         return 0;
     }
 
     if (stream->current_buffer != NULL) {
-        ebsp_message(err_create_opened);
+        ebsp_message_deferred(err_create_opened);
         return 0;
     }
 
     stream->current_buffer = ebsp_malloc(stream->max_chunksize + sizeof(int));
     if (stream->current_buffer == NULL) {
-        ebsp_message(err_out_of_memory);
+        ebsp_message_deferred(err_out_of_memory);
         return 0;
     }
 
-    (*address) = (void*)((unsigned)stream->current_buffer + sizeof(int));
+    (*address) = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
 
     // Set the size to max_chunksize
     int* header = (int*)stream->current_buffer;
@@ -91,19 +91,19 @@ int ebsp_open_up_stream(void** address, unsigned stream_id) {
 
 void ebsp_close_up_stream(unsigned stream_id) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return;
     }
 
     ebsp_stream_descriptor* out_stream = &coredata.local_streams[stream_id];
 
     if (out_stream->is_down_stream) {
-        ebsp_message(err_mixed_up_down);
+        ebsp_message_deferred(err_mixed_up_down);
         return;
     }
 
     if (out_stream->current_buffer == NULL) {
-        ebsp_message(err_close_closed);
+        ebsp_message_deferred(err_close_closed);
         return;
     }
 
@@ -122,14 +122,14 @@ void ebsp_close_up_stream(unsigned stream_id) {
 
 int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return 0;
     }
 
     ebsp_stream_descriptor* stream = &coredata.local_streams[stream_id];
 
     if (stream->is_down_stream) {
-        ebsp_message(err_mixed_up_down);
+        ebsp_message_deferred(err_mixed_up_down);
         return 0;
     }
 
@@ -145,7 +145,7 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
             stream->next_buffer =
                 ebsp_malloc(stream->max_chunksize + sizeof(int));
             if (stream->next_buffer == NULL) {
-                ebsp_message(err_out_of_memory);
+                ebsp_message_deferred(err_out_of_memory);
                 return 0;
             }
         }
@@ -153,7 +153,7 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
         // read int header from current_buffer (next size)
         int chunk_size = ((int*)stream->current_buffer)[0];
 
-        void* src = (void*)((unsigned)stream->current_buffer + sizeof(int));
+        void* src = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
         void* dst = stream->cursor;
 
         ebsp_dma_push(desc, dst, src, chunk_size); // start dma
@@ -174,7 +174,7 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
         // read int header from current_buffer (next size)
         int chunk_size = ((int*)stream->current_buffer)[0];
 
-        void* src = (void*)((unsigned)stream->current_buffer + sizeof(int));
+        void* src = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
         void* dst = stream->cursor;
 
         ebsp_dma_push(desc, dst, src, chunk_size); // start dma
@@ -184,7 +184,7 @@ int ebsp_move_chunk_up(void** address, unsigned stream_id, int prealloc) {
         stream->cursor += chunk_size; // move pointer in extmem
     }
 
-    (*address) = (void*)((unsigned)stream->current_buffer + sizeof(int));
+    (*address) = (void*)((uintptr_t)stream->current_buffer + sizeof(int));
 
     // Set the out_size to max_chunksize
     *((int*)(stream->current_buffer)) = stream->max_chunksize;
@@ -203,13 +203,14 @@ void _ebsp_write_chunk(ebsp_stream_descriptor* stream, void* target) {
         void* src = stream->cursor + 2 * sizeof(int);
 
         // jump over header+chunk
-        stream->cursor = (void*)(((unsigned)(stream->cursor)) +
+        stream->cursor = (void*)(((uintptr_t)(stream->cursor)) +
                                  2 * sizeof(int) + chunk_size);
 
         // If token is too large, truncate it.
         // However DO jump the correct distance with cursor
         if (chunk_size > stream->max_chunksize) {
-            ebsp_message(err_token_size2, chunk_size, stream->max_chunksize);
+            ebsp_message_deferred(err_token_size2, chunk_size,
+                                  stream->max_chunksize);
             chunk_size = stream->max_chunksize;
         }
 
@@ -225,18 +226,18 @@ void _ebsp_write_chunk(ebsp_stream_descriptor* stream, void* target) {
 
 int ebsp_open_down_stream(void** address, unsigned stream_id) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return 0;
     }
 
     ebsp_stream_descriptor* stream = &coredata.local_streams[stream_id];
 
     if (!stream->is_down_stream) {
-        ebsp_message(err_mixed_up_down);
+        ebsp_message_deferred(err_mixed_up_down);
         return 0;
     }
     if (stream->current_buffer != NULL || stream->next_buffer != NULL) {
-        ebsp_message(err_open_opened);
+        ebsp_message_deferred(err_open_opened);
         return 0;
     }
 
@@ -246,32 +247,32 @@ int ebsp_open_down_stream(void** address, unsigned stream_id) {
     // the first time
     stream->next_buffer = ebsp_malloc(stream->max_chunksize + 2 * sizeof(int));
     if (stream->next_buffer == NULL) {
-        ebsp_message(err_out_of_memory);
+        ebsp_message_deferred(err_out_of_memory);
         return 0;
     }
 
     _ebsp_write_chunk(stream, stream->next_buffer);
 
-    *address = (void*)((unsigned)stream->next_buffer + 2 * sizeof(int));
+    *address = (void*)((uintptr_t)stream->next_buffer + 2 * sizeof(int));
 
     return stream->max_chunksize;
 }
 
 void ebsp_close_down_stream(unsigned stream_id) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return;
     }
 
     ebsp_stream_descriptor* in_stream = &coredata.local_streams[stream_id];
 
     if (!(in_stream->is_down_stream)) {
-        ebsp_message(err_mixed_up_down);
+        ebsp_message_deferred(err_mixed_up_down);
         return;
     }
 
     if (in_stream->current_buffer == NULL) {
-        ebsp_message(err_close_closed);
+        ebsp_message_deferred(err_close_closed);
         return;
     }
 
@@ -289,7 +290,7 @@ void ebsp_close_down_stream(unsigned stream_id) {
 
 int ebsp_move_chunk_down(void** address, unsigned stream_id, int prealloc) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return 0;
     }
 
@@ -305,7 +306,7 @@ int ebsp_move_chunk_down(void** address, unsigned stream_id, int prealloc) {
     // this can be null the first time ebsp_move_chunk_down is called
 
     if (!(stream->is_down_stream)) {
-        ebsp_message(err_mixed_up_down);
+        ebsp_message_deferred(err_mixed_up_down);
         return 0;
     }
 
@@ -327,11 +328,11 @@ int ebsp_move_chunk_down(void** address, unsigned stream_id, int prealloc) {
     // Here: current_buffer contains data from THIS chunk
 
     // *address must point after the counter header
-    (*address) = (void*)((unsigned)stream->current_buffer + 2 * sizeof(int));
+    (*address) = (void*)((uintptr_t)stream->current_buffer + 2 * sizeof(int));
 
     // the counter header
     int current_chunk_size =
-        *((int*)((unsigned)stream->current_buffer + sizeof(int)));
+        *((int*)((uintptr_t)stream->current_buffer + sizeof(int)));
 
     if (current_chunk_size == 0) // stream has ended
     {
@@ -345,7 +346,7 @@ int ebsp_move_chunk_down(void** address, unsigned stream_id, int prealloc) {
             stream->next_buffer =
                 ebsp_malloc(stream->max_chunksize + 2 * sizeof(int));
             if (stream->next_buffer == NULL) {
-                ebsp_message(err_out_of_memory);
+                ebsp_message_deferred(err_out_of_memory);
                 return 0;
             }
         }
@@ -366,7 +367,7 @@ int ebsp_move_chunk_down(void** address, unsigned stream_id, int prealloc) {
 
 void ebsp_reset_down_cursor(int stream_id) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return;
     }
 
@@ -378,14 +379,14 @@ void ebsp_reset_down_cursor(int stream_id) {
     while (chunk_size != 0) {
         // read 1st int in (prev size) header from ext
         chunk_size = *(int*)(in_stream->cursor);
-        in_stream->cursor = (void*)(((unsigned)(in_stream->cursor)) -
+        in_stream->cursor = (void*)(((uintptr_t)(in_stream->cursor)) -
                                     2 * sizeof(int) - chunk_size);
     }
 }
 
 void ebsp_move_down_cursor(int stream_id, int jump_n_chunks) {
     if (stream_id >= coredata.local_nstreams) {
-        ebsp_message(err_no_such_stream);
+        ebsp_message_deferred(err_no_such_stream);
         return;
     }
 
@@ -397,10 +398,10 @@ void ebsp_move_down_cursor(int stream_id, int jump_n_chunks) {
             // read 2nd int in (next size) header from ext
             size_t chunk_size = *(int*)(in_stream->cursor + sizeof(int));
             if (chunk_size == 0) {
-                ebsp_message(err_jump_out_of_bounds);
+                ebsp_message_deferred(err_jump_out_of_bounds);
                 return;
             }
-            in_stream->cursor = (void*)(((unsigned)(in_stream->cursor)) +
+            in_stream->cursor = (void*)(((uintptr_t)(in_stream->cursor)) +
                                         2 * sizeof(int) + chunk_size);
         }
     } else // jump backward
@@ -409,10 +410,10 @@ void ebsp_move_down_cursor(int stream_id, int jump_n_chunks) {
             // read 1st int in (prev size) header from ext
             int chunk_size = *(int*)(in_stream->cursor);
             if (chunk_size == 0) {
-                ebsp_message(err_jump_out_of_bounds);
+                ebsp_message_deferred(err_jump_out_of_bounds);
                 return;
             }
-            in_stream->cursor = (void*)(((unsigned)(in_stream->cursor)) -
+            in_stream->cursor = (void*)(((uintptr_t)(in_stream->cursor)) -
                                         2 * sizeof(int) - chunk_size);
         }
     }
@@ -29,12 +29,12 @@ void _prepare_descriptor(e_dma_desc_t* desc, void* dst, const void* src,
                          size_t nbytes) {
     // Alignment
     unsigned index =
-        (((unsigned)dst) | ((unsigned)src) | ((unsigned)nbytes)) & 7;
+        (((uintptr_t)dst) | ((uintptr_t)src) | ((uintptr_t)nbytes)) & 7;
     unsigned shift = dma_data_size[index] >> 5;
 
     desc->config =
         E_DMA_MASTER | E_DMA_ENABLE | E_DMA_IRQEN | dma_data_size[index];
-    if ((((unsigned)dst) & local_mask) == 0)
+    if ((((uintptr_t)dst) & local_mask) == 0)
         desc->config |= E_DMA_MSGMODE;
     desc->inner_stride = 0x00010001 << shift;
     desc->count = 0x00010000 | (nbytes >> shift);
@@ -43,16 +43,44 @@ void _prepare_descriptor(e_dma_desc_t* desc, void* dst, const void* src,
     desc->dst_addr = (void*)dst;
 }
 
-void ebsp_dma_push(ebsp_dma_handle* descriptor, void* dst, const void* src,
-                   size_t nbytes) {
-    if (nbytes == 0)
-        return;
+// Two-dimensional version of _prepare_descriptor, for count blocks of
+// nbytes. Returns 0 if the counts or strides do not fit in the descriptor
+int _prepare_descriptor_2d(e_dma_desc_t* desc, void* dst, const void* src,
+                           size_t nbytes, unsigned count, int dst_stride,
+                           int src_stride) {
+    unsigned index = (((uintptr_t)dst) | ((uintptr_t)src) |
+                      ((uintptr_t)nbytes) | dst_stride | src_stride) & 7;
+    unsigned shift = dma_data_size[index] >> 5;
 
-    e_dma_desc_t* desc = (e_dma_desc_t*)descriptor;
+    // The outer stride is added instead of the inner stride at the end of
+    // every block, and both are signed 16-bit numbers
+    int dst_outer = dst_stride - (int)nbytes + (1 << shift);
+    int src_outer = src_stride - (int)nbytes + (1 << shift);
+    if (count > 0xffff || (nbytes >> shift) > 0xffff ||
+        dst_outer != (int16_t)dst_outer || src_outer != (int16_t)src_outer)
+        return 0;
 
-    // Set the contents of the descriptor
-    _prepare_descriptor(desc, dst, src, nbytes);
+    desc->config =
+        E_DMA_MASTER | E_DMA_ENABLE | E_DMA_IRQEN | dma_data_size[index];
+    if ((((uintptr_t)dst) & local_mask) == 0)
+        desc->config |= E_DMA_MSGMODE;
+    desc->inner_stride = 0x00010001 << shift;
+    desc->count = (count << 16) | (nbytes >> shift);
+    desc->outer_stride = ((unsigned)dst_outer << 16) | (src_outer & 0xffff);
+    desc->src_addr = (void*)src;
+    desc->dst_addr = (void*)dst;
+    return 1;
+}
 
+#ifdef EBSP_EMULATOR
+// The emulated DMA engine keeps its own queue of descriptors,
+// so there is no chain to maintain here
+void _push_descriptor(e_dma_desc_t* desc) { e_dma_start(desc, E_DMA_1); }
+
+// Never raised in the emulator, but bsp_begin attaches it
+void INTERRUPT_HANDLER _dma_interrupt() {}
+#else
+void _push_descriptor(e_dma_desc_t* desc) {
     // Take the end of the current descriptor chain
     e_dma_desc_t* last = coredata.last_dma_desc;
 
@@ -90,7 +118,7 @@ void ebsp_dma_push(ebsp_dma_handle* descriptor, void* dst, const void* src,
     }
 }
 
-void __attribute__((interrupt)) _dma_interrupt() {
+void INTERRUPT_HANDLER _dma_interrupt() {
     // If DMA is in chaining mode, an interrupt will be fired after a chain
     // element is completed. At this point in the interrupt, the DMA will
     // already be busy doing the next element of the chain or even the one
@@ -132,10 +160,87 @@ void __attribute__((interrupt)) _dma_interrupt() {
         *coredata.dma1config = kickstart;
     }
 }
+#endif
+
+void ebsp_dma_push(ebsp_dma_handle* descriptor, void* dst, const void* src,
+                   size_t nbytes) {
+    if (nbytes == 0)
+        return;
+
+    e_dma_desc_t* desc = (e_dma_desc_t*)descriptor;
+
+    // Set the contents of the descriptor
+    _prepare_descriptor(desc, dst, src, nbytes);
+    _push_descriptor(desc);
+}
 
 void ebsp_dma_wait(ebsp_dma_handle* descriptor) {
+#ifdef EBSP_EMULATOR
+    e_emu_dma_wait((e_dma_desc_t*)descriptor);
+#endif
     volatile unsigned* config = &descriptor->config;
     while (*config & E_DMA_ENABLE) {
     }
 }
 
+// Descriptor of _sync_copy that is used next, after its previous task
+static ebsp_dma_handle* _next_sync_descriptor() {
+    ebsp_dma_handle* desc = &coredata.sync_dma[coredata.sync_dma_next];
+    coredata.sync_dma_next =
+        (coredata.sync_dma_next + 1) % SYNC_DMA_DESCRIPTORS;
+    ebsp_dma_wait(desc);
+    coredata.sync_dma_pushed++;
+    return desc;
+}
+
+// Copy the data of a request in bsp_sync. The cpu copies small requests,
+// because starting the DMA engine takes longer. Larger ones are added to
+// the DMA chain, so they are only finished after _sync_copy_wait
+void _sync_copy(void* dst, const void* src, unsigned int nbytes) {
+    if (nbytes < SYNC_DMA_MIN_SIZE) {
+        ebsp_memcpy(dst, src, nbytes);
+        return;
+    }
+
+    while (nbytes > 0) {
+        unsigned int chunk = nbytes;
+        if (chunk > SYNC_DMA_CHUNK)
+            chunk = SYNC_DMA_CHUNK;
+
+        ebsp_dma_push(_next_sync_descriptor(), dst, src, chunk);
+
+        dst = (char*)dst + chunk;
+        src = (const char*)src + chunk;
+        nbytes -= chunk;
+    }
+}
+
+// Copy count blocks of nbytes, which are src_stride bytes apart in the
+// source and dst_stride bytes apart in the destination, as a single
+// two-dimensional DMA task when possible
+void _sync_copy_strided(void* dst, const void* src, unsigned int nbytes,
+                        unsigned int count, int dst_stride, int src_stride) {
+    if (count * nbytes >= SYNC_DMA_MIN_SIZE) {
+        e_dma_desc_t desc;
+        if (_prepare_descriptor_2d(&desc, dst, src, nbytes, count,
+                                   dst_stride, src_stride)) {
+            e_dma_desc_t* sync_desc = (e_dma_desc_t*)_next_sync_descriptor();
+            *sync_desc = desc;
+            _push_descriptor(sync_desc);
+            return;
+        }
+    }
+
+    for (unsigned int i = 0; i < count; ++i)
+        ebsp_memcpy((char*)dst + i * dst_stride,
+                    (const char*)src + i * src_stride, nbytes);
+}
+
+void _sync_copy_wait() {
+    if (coredata.sync_dma_pushed == 0)
+        return;
+    for (int i = 0; i < SYNC_DMA_DESCRIPTORS; ++i)
+        ebsp_dma_wait(&coredata.sync_dma[i]);
+    coredata.sync_dma_pushed = 0;
+}
+
@@ -24,7 +24,16 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include <string.h>
 
 const char err_pushreg_overflow[] EXT_MEM_RO =
-    "BSP ERROR: Trying to push more than MAX_BSP_VARS vars";
+    "BSP ERROR: Trying to push more than %u vars";
+
+const char err_var_list_memory[] EXT_MEM_RO =
+    "BSP ERROR: not enough local memory for %u bsp vars";
+
+const char err_put_buffer_memory[] EXT_MEM_RO =
+    "BSP ERROR: not enough local memory for a put buffer of %u bytes";
+
+const char err_get_inbox_memory[] EXT_MEM_RO =
+    "BSP ERROR: not enough local memory for get inboxes of %u requests";
 
 const char err_var_not_found[] EXT_MEM_RO =
     "BSP ERROR: could not find bsp var %p";
@@ -38,86 +47,267 @@ const char err_put_overflow[] EXT_MEM_RO =
 const char err_put_overflow2[] EXT_MEM_RO =
     "BSP ERROR: too large bsp_put payload per sync";
 
+// Address of a local address of core pid in the epiphany global address
+// system. Global addresses are returned as they are
+static inline void* _global_address(int pid, const volatile void* ptr) {
+#ifdef EBSP_EMULATOR
+    // Local addresses are not a fixed range in the emulator
+    // so let e-lib translate them to the remote core
+    unsigned row = pid / e_group_config.group_cols;
+    unsigned col = pid % e_group_config.group_cols;
+    return e_get_global_address(row, col, (const void*)ptr);
+#else
+    // If it was local, add the remote coreid in the highest 12 bits
+    unsigned uptr = (unsigned)ptr;
+    if ((uptr & 0xfff00000) == 0) // local
+        uptr |= ((uint32_t)coredata.coreids[pid]) << 20;
+    return (void*)uptr;
+#endif
+}
+
+// Address of the variable in a slot of bsp_var_list on a remote core,
+// in the epiphany global address system
+void* _resolve_remote_addr(int pid, int slot) {
+    // Read the remote copy of the BSP var list
+    void** remote_var_list =
+        _global_address(pid, &coredata.bsp_var_list[slot]);
+    return _global_address(pid, *remote_var_list);
+}
+
+static inline uint32_t _var_bucket(const void* variable) {
+    return ((uintptr_t)variable >> 2) & coredata.var_bucket_mask;
+}
+
+// Slot of a variable in bsp_var_list, or -1
+int _find_var_slot(const void* variable) {
+    uint32_t next = coredata.var_buckets[_var_bucket(variable)];
+    while (next != 0) {
+        int slot = next - 1;
+        if (coredata.bsp_var_list[slot] == variable)
+            return slot;
+        next = coredata.var_next[slot];
+    }
+    return -1;
+}
+
+// Called in bsp_begin by every core, before any other allocation of local
+// memory, so that the var list has the same address on every core
+void EXT_MEM_TEXT _init_var_list() {
+    uint32_t count = combuf->max_bsp_vars;
+    if (count == 0)
+        count = MAX_BSP_VARS;
+
+    // At least two slots per bucket, with a power of two buckets
+    uint32_t buckets = 1;
+    while (2 * buckets < count)
+        buckets *= 2;
+
+    unsigned int nbytes = count * sizeof(void*) +
+                          (count + buckets) * sizeof(uint16_t);
+    void* table = ebsp_malloc(nbytes);
+    if (table == 0) {
+        // Only an empty bucket, so that every lookup fails
+        ebsp_message_deferred(err_var_list_memory, count);
+        count = 0;
+        buckets = 1;
+        nbytes = sizeof(uint16_t);
+        table = ebsp_malloc(nbytes);
+    }
+    memset(table, 0, nbytes);
+
+    coredata.bsp_var_list = table;
+    coredata.max_bsp_vars = count;
+    coredata.var_next = table + count * sizeof(void*);
+    coredata.var_buckets = coredata.var_next + count;
+    coredata.var_bucket_mask = buckets - 1;
+}
+
+void EXT_MEM_TEXT _init_put_buffer() {
+    uint32_t nbytes = combuf->put_buffer_size & ~7;
+    if (nbytes == 0)
+        return;
+    coredata.put_buffer = ebsp_malloc(nbytes);
+    if (coredata.put_buffer == 0)
+        return ebsp_message_deferred(err_put_buffer_memory, nbytes);
+    coredata.put_buffer_size = nbytes;
+}
+
+// Called in bsp_begin right after _init_var_list, so that the inboxes have
+// the same address on every core
+void EXT_MEM_TEXT _init_get_inbox() {
+    uint32_t size = combuf->get_inbox_size;
+    if (size == 0)
+        return;
+    unsigned int nbytes = sizeof(ebsp_get_inbox) +
+                          coredata.nprocs * size * sizeof(ebsp_data_request);
+    for (int i = 0; i < 2; i++) {
+        ebsp_get_inbox* inbox = ebsp_malloc(nbytes);
+        if (inbox == 0) {
+            // Every core runs out of memory at the same point
+            if (i == 1)
+                ebsp_free(coredata.get_inbox[0]);
+            coredata.get_inbox[0] = 0;
+            return ebsp_message_deferred(err_get_inbox_memory, size);
+        }
+        memset(inbox, 0, sizeof(ebsp_get_inbox));
+        coredata.get_inbox[i] = inbox;
+    }
+    coredata.get_inbox_size = size;
+}
+
+// Called in bsp_sync before the puts in external memory, which were made
+// after the buffer was full
+void _flush_put_buffer() {
+    uint32_t offset = 0;
+    uint32_t used = coredata.put_buffer_used;
+    while (offset < used) {
+        ebsp_put_header* header =
+            (ebsp_put_header*)(coredata.put_buffer + offset);
+        _sync_copy(header->dst, header + 1, header->nbytes);
+        offset += (sizeof(ebsp_put_header) + header->nbytes + 7) & ~7;
+    }
+    coredata.put_buffer_used = 0;
+    coredata.put_buffer_full = 0;
+}
+
+// Store a bsp_put in the local put buffer. Returns 0 if it does not fit
+static inline int _buffer_put(const void* src, void* dst_remote, int nbytes) {
+    uint32_t size = (sizeof(ebsp_put_header) + nbytes + 7) & ~7;
+    uint32_t offset = coredata.put_buffer_used;
+    if (coredata.put_buffer_full || offset + size > coredata.put_buffer_size) {
+        coredata.put_buffer_full = 1;
+        return 0;
+    }
+    ebsp_put_header* header = (ebsp_put_header*)(coredata.put_buffer + offset);
+    header->dst = dst_remote;
+    header->nbytes = nbytes;
+    ebsp_memcpy(header + 1, src, nbytes);
+    coredata.put_buffer_used = offset + size;
+    return 1;
+}
+
 // This incoroporates the bsp_var_list as well as
 // the epiphany global address system
 // The resulting address can be written to directly
 void* _get_remote_addr(int pid, const void* addr, int offset) {
-    // Find the slot for our local pid
-    // And return the entry for the remote pid including the epiphany mapping
-    for (int slot = 0; slot < MAX_BSP_VARS; ++slot) {
-        if (coredata.bsp_var_list[slot] == addr) {
-            // Get the remote copy of the BSP var list
-            unsigned remote_var_list = (unsigned)&(coredata.bsp_var_list[slot]);
-            remote_var_list |= ((uint32_t)coredata.coreids[pid]) << 20;
-            // Read its value
-            unsigned remote_ptr = *(unsigned*)remote_var_list;
-            // Add the offset
-            unsigned uptr = remote_ptr + offset;
-
-            // If it was global, then it is directly valid from here
-            // If it was local, add the remote coreid in the highest 12 bits
-            if ((uptr & 0xfff00000) == 0) // local
-                uptr |= ((uint32_t)coredata.coreids[pid]) << 20;
-
-            return (void*)uptr;
+    // Most calls use a variable of the cache, and do not read the
+    // var list of the remote core
+    ebsp_var_cache_entry* entry = 0;
+    for (int i = 0; i < VAR_CACHE_SIZE; ++i) {
+        if (coredata.var_cache[i].variable == addr) {
+            entry = &coredata.var_cache[i];
+            void* remote = entry->remote[pid];
+            if (remote)
+                return remote + offset;
+            break;
         }
     }
-    ebsp_message(err_var_not_found, addr);
-    return 0;
+
+    // Find the slot for our local pid
+    // And store the entry for the remote pid in the cache
+    int slot = (addr != 0) ? _find_var_slot(addr) : -1;
+    if (slot < 0) {
+        ebsp_message_deferred(err_var_not_found, addr);
+        return 0;
+    }
+    if (entry == 0) {
+        entry = &coredata.var_cache[coredata.var_cache_next];
+        coredata.var_cache_next =
+            (coredata.var_cache_next + 1) % VAR_CACHE_SIZE;
+        entry->variable = addr;
+        for (int p = 0; p < NPROCS; ++p)
+            entry->remote[p] = 0;
+    }
+    entry->remote[pid] = _resolve_remote_addr(pid, slot);
+    return entry->remote[pid] + offset;
+}
+
+// Called in bsp_sync, after all cores have registered their variables.
+// The cache is cleared when the registrations changed, and then holds
+// the newest variables, with their addresses on every core
+void EXT_MEM_TEXT _update_var_cache() {
+    if (coredata.vars_changed == 0)
+        return;
+    for (int i = 0; i < VAR_CACHE_SIZE; ++i)
+        coredata.var_cache[i].variable = 0;
+    coredata.var_cache_next = 0;
+
+    uint32_t pushes = coredata.vars_pushed;
+    uint32_t first = (pushes > VAR_CACHE_SIZE) ? pushes - VAR_CACHE_SIZE : 0;
+    for (uint32_t i = first; i < pushes; ++i) {
+        uint32_t slot = coredata.var_pushed_slot[i % VAR_CACHE_SIZE];
+        const void* variable = coredata.bsp_var_list[slot];
+        if (variable == 0)
+            continue;
+        ebsp_var_cache_entry* entry =
+            &coredata.var_cache[coredata.var_cache_next];
+        coredata.var_cache_next =
+            (coredata.var_cache_next + 1) % VAR_CACHE_SIZE;
+        entry->variable = variable;
+        for (int p = 0; p < NPROCS; ++p)
+            entry->remote[p] =
+                (p < coredata.nprocs) ? _resolve_remote_addr(p, slot) : 0;
+    }
+    coredata.vars_changed = 0;
+    coredata.vars_pushed = 0;
 }
 
 void EXT_MEM_TEXT bsp_push_reg(const void* variable, const int nbytes) {
-    for (size_t i = 0; i < MAX_BSP_VARS; i++) {
+    for (uint32_t i = 0; i < coredata.max_bsp_vars; i++) {
         if (coredata.bsp_var_list[i] == 0) {
             coredata.bsp_var_list[i] = (void*)variable;
+            uint16_t* bucket = &coredata.var_buckets[_var_bucket(variable)];
+            coredata.var_next[i] = *bucket;
+            *bucket = i + 1;
+
+            coredata.vars_changed = 1;
+            coredata.var_pushed_slot[coredata.vars_pushed % VAR_CACHE_SIZE] =
+                i;
+            coredata.vars_pushed++;
             return;
         }
     }
-    return ebsp_message(err_pushreg_overflow);
+    return ebsp_message_deferred(err_pushreg_overflow,
+                                 (unsigned int)coredata.max_bsp_vars);
 }
 
 void EXT_MEM_TEXT bsp_pop_reg(const void* variable) {
-    for (size_t i = 0; i < MAX_BSP_VARS; i++)
-        if (coredata.bsp_var_list[i] == variable)
-            coredata.bsp_var_list[i] = 0;
+    // Remove every slot of the variable from its bucket
+    uint16_t* link = &coredata.var_buckets[_var_bucket(variable)];
+    while (*link != 0) {
+        int slot = *link - 1;
+        if (coredata.bsp_var_list[slot] == variable) {
+            coredata.bsp_var_list[slot] = 0;
+            *link = coredata.var_next[slot];
+            coredata.vars_changed = 1;
+        } else {
+            link = &coredata.var_next[slot];
+        }
+    }
     return;
 }
 
 void EXT_MEM_TEXT
 bsp_put(int pid, const void* src, void* dst, int offset, int nbytes) {
-    // Check if we can store the request
-    if (coredata.request_counter >= MAX_DATA_REQUESTS)
-        return ebsp_message(err_put_overflow);
-
     // Find remote address
     void* dst_remote = _get_remote_addr(pid, dst, offset);
     if (!dst_remote)
         return;
 
-    // Check if we can store the payload
-    // A mutex is needed for this.
-    // While holding the mutex this core checks if it can store
-    // the payload and if so, updates the buffer
-    // Note that the mutex is NOT held while writing the payload itself
-    // A possible error message is given after unlocking
-    unsigned int payload_offset;
-
-    e_mutex_lock(0, 0, &coredata.payload_mutex);
-
-    payload_offset = combuf->data_payloads.buffer_size;
-
-    if (payload_offset + nbytes > MAX_PAYLOAD_SIZE)
-        payload_offset = -1;
-    else
-        combuf->data_payloads.buffer_size += nbytes;
+    // Most puts fit in the local buffer, if the host turned it on
+    if (_buffer_put(src, dst_remote, nbytes))
+        return;
 
-    e_mutex_unlock(0, 0, &coredata.payload_mutex);
+    // Check if we can store the request
+    if (coredata.request_counter >= MAX_DATA_REQUESTS)
+        return ebsp_message_deferred(err_put_overflow);
 
-    if (payload_offset == -1)
-        return ebsp_message(err_put_overflow2);
+    // Check if we can store the payload
+    void* payload_ptr = _reserve_payload(nbytes);
+    if (payload_ptr == 0)
+        return ebsp_message_deferred(err_put_overflow2);
 
     // We are now ready to save the request and payload
-    void* payload_ptr = &combuf->data_payloads.buf[payload_offset];
 
     // TODO(Tom)
     // Measure if e_dma_copy is faster here for both request and payload
@@ -134,6 +324,42 @@ bsp_put(int pid, const void* src, void* dst, int offset, int nbytes) {
     ebsp_memcpy(payload_ptr, src, nbytes);
 }
 
+void EXT_MEM_TEXT ebsp_put_strided(int pid, const void* src, void* dst,
+                                   int offset, int count, int nbytes,
+                                   int src_stride, int dst_stride) {
+    if (count <= 0 || nbytes <= 0)
+        return;
+    if (coredata.request_counter + 2 > MAX_DATA_REQUESTS)
+        return ebsp_message_deferred(err_put_overflow);
+
+    void* dst_remote = _get_remote_addr(pid, dst, offset);
+    if (!dst_remote)
+        return;
+
+    // The blocks are next to each other in the payload
+    char* payload_ptr = _reserve_payload(count * nbytes);
+    if (payload_ptr == 0)
+        return ebsp_message_deferred(err_put_overflow2);
+    for (int i = 0; i < count; ++i)
+        ebsp_memcpy(payload_ptr + i * nbytes, (const char*)src + i * src_stride,
+                    nbytes);
+
+    // Later puts can not use the local put buffer, because that is
+    // written before the requests in external memory
+    coredata.put_buffer_full = 1;
+
+    uint32_t req_count = coredata.request_counter;
+    ebsp_data_request* req = &combuf->data_requests[coredata.pid][req_count];
+    req->src = payload_ptr;
+    req->dst = dst_remote;
+    req->nbytes = nbytes | DATA_PUT_BIT | DATA_STRIDED_BIT;
+    ebsp_data_strides* strides = (ebsp_data_strides*)(req + 1);
+    strides->count = count;
+    strides->src_stride = nbytes;
+    strides->dst_stride = dst_stride;
+    coredata.request_counter = req_count + 2;
+}
+
 void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes) {
     void* dst_remote = _get_remote_addr(pid, dst, offset);
     if (!dst_remote)
@@ -141,14 +367,76 @@ void bsp_hpput(int pid, const void* src, void* dst, int offset, int nbytes) {
     ebsp_memcpy(dst_remote, src, nbytes);
 }
 
+// Ask core pid to write data to this core, which is faster than reading it
+// from here. Returns 0 when the inbox on core pid is full or turned off.
+// The entry is written before the head, so the owner never sees an
+// incomplete request
+int _forward_get(int inbox_id, int pid, const void* src_remote, void* dst,
+                 int nbytes) {
+    ebsp_get_inbox* inbox = coredata.get_inbox[inbox_id];
+    uint32_t size = coredata.get_inbox_size;
+    if (inbox == 0)
+        return 0;
+
+    uint32_t head = inbox->sent[pid];
+    if (head - inbox->served[pid] >= size) {
+        inbox->served[pid] =
+            *(uint32_t*)_global_address(pid, &inbox->tail[coredata.pid]);
+        if (head - inbox->served[pid] >= size)
+            return 0;
+    }
+
+    volatile ebsp_data_request* req = _global_address(
+        pid, &inbox->requests[coredata.pid * size + head % size]);
+    req->src = src_remote;
+    req->dst = _global_address(coredata.pid, dst);
+    req->nbytes = nbytes;
+    WRITE_FENCE();
+    inbox->sent[pid] = head + 1;
+    *(volatile uint32_t*)_global_address(pid, &inbox->head[coredata.pid]) =
+        head + 1;
+    return 1;
+}
+
+static void _serve_inbox(ebsp_get_inbox* inbox, int all) {
+    uint32_t size = coredata.get_inbox_size;
+    for (int pid = 0; pid < coredata.nprocs; ++pid) {
+        uint32_t tail = inbox->tail[pid];
+        uint32_t head = inbox->head[pid];
+        for (; tail != head; ++tail) {
+            volatile ebsp_data_request* req =
+                &inbox->requests[pid * size + tail % size];
+            _sync_copy(req->dst, req->src, req->nbytes);
+        }
+        inbox->tail[pid] = tail;
+        if (all)
+            inbox->served[pid] = inbox->sent[pid];
+    }
+}
+
+// Write the data of forwarded gets to the cores that asked for it. In
+// bsp_sync both inboxes are served, and the inboxes on the other cores are
+// empty afterwards. In ebsp_barrier only the inbox of ebsp_hpget_push is
+// served, so a bsp_get does not hold up the gets behind it
+void _serve_gets(int all) {
+    if (coredata.get_inbox[GET_INBOX_HP] == 0)
+        return;
+    if (all)
+        _serve_inbox(coredata.get_inbox[GET_INBOX_SYNC], 1);
+    _serve_inbox(coredata.get_inbox[GET_INBOX_HP], all);
+}
+
 void EXT_MEM_TEXT
 bsp_get(int pid, const void* src, int offset, void* dst, int nbytes) {
-    if (coredata.request_counter >= MAX_DATA_REQUESTS)
-        return ebsp_message(err_get_overflow);
     const void* src_remote = _get_remote_addr(pid, src, offset);
     if (!src_remote)
         return;
+    if (_forward_get(GET_INBOX_SYNC, pid, src_remote, dst, nbytes))
+        return;
 
+    // The inbox is full, so this core reads the data in bsp_sync
+    if (coredata.request_counter >= MAX_DATA_REQUESTS)
+        return ebsp_message_deferred(err_get_overflow);
     uint32_t req_count = coredata.request_counter;
     ebsp_data_request* req = &combuf->data_requests[coredata.pid][req_count];
     req->src = src_remote;
@@ -164,6 +452,113 @@ void bsp_hpget(int pid, const void* src, int offset, void* dst, int nbytes) {
     ebsp_memcpy(dst, src_remote, nbytes);
 }
 
+void EXT_MEM_TEXT ebsp_get_strided(int pid, const void* src, int offset,
+                                   void* dst, int count, int nbytes,
+                                   int src_stride, int dst_stride) {
+    if (count <= 0 || nbytes <= 0)
+        return;
+    if (coredata.request_counter + 2 > MAX_DATA_REQUESTS)
+        return ebsp_message_deferred(err_get_overflow);
+    const void* src_remote = _get_remote_addr(pid, src, offset);
+    if (!src_remote)
+        return;
+
+    // This core reads the data in bsp_sync, because the inbox of forwarded
+    // gets has no room for the strides
+    uint32_t req_count = coredata.request_counter;
+    ebsp_data_request* req = &combuf->data_requests[coredata.pid][req_count];
+    req->src = src_remote;
+    req->dst = dst;
+    req->nbytes = nbytes | DATA_STRIDED_BIT;
+    ebsp_data_strides* strides = (ebsp_data_strides*)(req + 1);
+    strides->count = count;
+    strides->src_stride = src_stride;
+    strides->dst_stride = dst_stride;
+    coredata.request_counter = req_count + 2;
+}
+
+void ebsp_hpget_push(int pid, const void* src, int offset, void* dst,
+                     int nbytes) {
+    const void* src_remote = _get_remote_addr(pid, src, offset);
+    if (!src_remote)
+        return;
+    // Reading the data now is also allowed when the inbox is full
+    if (!_forward_get(GET_INBOX_HP, pid, src_remote, dst, nbytes))
+        ebsp_memcpy(dst, src_remote, nbytes);
+}
+
+// The atomic operations hold the mutex of the core that owns the
+// variable, which is built on TESTSET. The old value is read and the new
+// one is written in the same remote core, so they arrive in order
+static inline volatile int* _atomic_begin(int pid, void* variable,
+                                          int offset) {
+    volatile int* remote = _get_remote_addr(pid, variable, offset);
+    if (remote)
+        e_mutex_lock(pid / e_group_config.group_cols,
+                     pid % e_group_config.group_cols, &coredata.atomic_mutex);
+    return remote;
+}
+
+static inline void _atomic_end(int pid) {
+    e_mutex_unlock(pid / e_group_config.group_cols,
+                   pid % e_group_config.group_cols, &coredata.atomic_mutex);
+}
+
+int ebsp_atomic_fetch_add(int pid, void* variable, int offset, int value) {
+    volatile int* remote = _atomic_begin(pid, variable, offset);
+    if (!remote)
+        return 0;
+    int old = *remote;
+    *remote = old + value;
+    _atomic_end(pid);
+    return old;
+}
+
+int ebsp_atomic_swap(int pid, void* variable, int offset, int value) {
+    volatile int* remote = _atomic_begin(pid, variable, offset);
+    if (!remote)
+        return 0;
+    int old = *remote;
+    *remote = value;
+    _atomic_end(pid);
+    return old;
+}
+
+int ebsp_atomic_cas(int pid, void* variable, int offset, int expected,
+                    int desired) {
+    volatile int* remote = _atomic_begin(pid, variable, offset);
+    if (!remote)
+        return 0;
+    int old = *remote;
+    if (old == expected)
+        *remote = desired;
+    _atomic_end(pid);
+    return old;
+}
+
+void ebsp_put_notify(int pid, const void* src, void* dst, int offset,
+                     int nbytes, void* flag) {
+    void* dst_remote = _get_remote_addr(pid, dst, offset);
+    if (!dst_remote)
+        return;
+    ebsp_memcpy(dst_remote, src, nbytes);
+
+    // The data and the counter are written to the same core, so the chip
+    // delivers them in order. The counter takes the mutex of that core, so
+    // several cores can notify the same counter
+    WRITE_FENCE();
+    ebsp_atomic_fetch_add(pid, flag, 0, 1);
+}
+
+void ebsp_wait_notify(void* flag, int count) {
+    volatile int* counter = flag;
+    while (*counter < count) {
+        SPIN_WAIT();
+    }
+    // Notifications that arrived in the meantime are kept
+    ebsp_atomic_fetch_add(coredata.pid, flag, 0, -count);
+}
+
 void* ebsp_get_direct_address(int pid, const void* variable) {
     return _get_remote_addr(pid, variable, 0);
 }
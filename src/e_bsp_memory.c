@@ -28,67 +28,274 @@ see the files COPYING and COPYING.LESSER. If not, see
 const char err_allocation[] EXT_MEM_RO = 
     "BSP ERROR: allocation of %d bytes of local memory overwrites the stack";
 
+const char err_host_heap_free[] EXT_MEM_RO =
+    "BSP ERROR: memory of the host heap at %p can only be freed by the host";
 
+const char err_arena_free[] EXT_MEM_RO =
+    "BSP ERROR: memory of an ext arena at %p can only be freed by its core";
+
+
+#ifdef EBSP_EMULATOR
+// The emulated local store only holds the heap, see src/emulator/e_lib.c
+#define local_heap_start \
+    ((uintptr_t)e_emu_local_store + E_EMU_LOCAL_RESERVED)
+#define local_heap_end ((uintptr_t)e_emu_local_store + E_EMU_LOCAL_STORE_SIZE)
+#define local_store_start ((uintptr_t)e_emu_local_store)
+#define is_extmem_address(ptr) ((uintptr_t)(ptr) - E_EXTMEM_ADDR < EXTMEM_SIZE)
+#else
 // This variable indicates end of global vars
 // So 'end' until 'stack' can be used by malloc
 extern int end;
+#define local_heap_start ((uintptr_t)(&end + 8))
+#define local_heap_end 0x8000
+#define local_store_start 0
+#define is_extmem_address(ptr) (((unsigned)(ptr)) & 0xfff00000)
+#endif
 
 // Called in bsp_begin by every core
 void EXT_MEM_TEXT _init_local_malloc() {
-    coredata.local_malloc_base = (void*)chunk_roundup((uint32_t)(&end + 8));
-    uint32_t size = 0x8000 - (uint32_t)coredata.local_malloc_base;
+    coredata.local_malloc_base = (void*)chunk_roundup(local_heap_start);
+    uint32_t size = local_heap_end - (uintptr_t)coredata.local_malloc_base;
     _init_malloc_state(coredata.local_malloc_base, size);
+
+    // Chunk numbers of the bank boundaries. Chunks are aligned, so no chunk
+    // is in two banks
+    void* base = coredata.local_malloc_base;
+    uintptr_t alloc_base = (uintptr_t)get_alloc_base(base);
+    uint32_t total = 32 * get_bitmask_count(base);
+    for (int bank = 0; bank <= LOCAL_BANKS; bank++) {
+        uintptr_t start = local_store_start + bank * LOCAL_BANK_SIZE;
+        uint32_t chunk = 0;
+        if (start > alloc_base)
+            chunk = (start - alloc_base) / CHUNK_SIZE;
+        if (chunk > total)
+            chunk = total;
+        coredata.local_bank_chunk[bank] = chunk;
+    }
 }
 
 void* EXT_MEM_TEXT ebsp_ext_malloc(unsigned int nbytes) {
     void* ret = 0;
+
+    // The arena is taken from the shared memory, with the mutex
+    if (!coredata.ext_arena_reserved) {
+        coredata.ext_arena_reserved = 1;
+        uint32_t size = combuf->ext_arena_size;
+        if (size != 0) {
+            e_mutex_lock(0, 0, &coredata.malloc_mutex);
+            ret = _malloc(dynmem, size);
+            e_mutex_unlock(0, 0, &coredata.malloc_mutex);
+            if (ret) {
+                coredata.ext_arena_start = ret;
+                coredata.ext_arena_cursor = ret;
+                coredata.ext_arena_end = ret + size;
+            }
+        }
+    }
+
+    // Allocations from the arena do not read external memory. Their
+    // header has a chunk count of 0, so that only this core frees them
+    uint32_t size = sizeof(memory_object) + chunk_roundup(nbytes);
+    if (coredata.ext_arena_start &&
+        coredata.ext_arena_end - coredata.ext_arena_cursor >= size) {
+        memory_object* block = coredata.ext_arena_cursor;
+        block->chunk_count = 0;
+        block->next_free = 0;
+        coredata.ext_arena_cursor += size;
+        coredata.ext_arena_live++;
+        return block + 1;
+    }
+
     e_mutex_lock(0, 0, &coredata.malloc_mutex);
-    ret = _malloc((void*)E_DYNMEM_ADDR, nbytes);
+    ret = _malloc(dynmem, nbytes);
     e_mutex_unlock(0, 0, &coredata.malloc_mutex);
     return ret;
 }
 
-void* EXT_MEM_TEXT ebsp_malloc(unsigned int nbytes) {
-    void* ret = 0;
-    ret = _malloc(coredata.local_malloc_base, nbytes);
+// Called in bsp_end. An arena with allocations that were not freed is
+// kept, like other memory of ebsp_ext_malloc. The next run of
+// ebsp_next_run uses it as well, and it is released at the end of the
+// first run after which it is empty
+void EXT_MEM_TEXT _release_ext_arena() {
+    if (coredata.ext_arena_live != 0)
+        return;
+    if (coredata.ext_arena_start) {
+        e_mutex_lock(0, 0, &coredata.malloc_mutex);
+        _free(dynmem, coredata.ext_arena_start);
+        e_mutex_unlock(0, 0, &coredata.malloc_mutex);
+    }
+    coredata.ext_arena_start = 0;
+    coredata.ext_arena_cursor = 0;
+    coredata.ext_arena_end = 0;
+    coredata.ext_arena_reserved = 0;
+}
 
+// Returns ret, or frees it and returns 0 when it overlaps with the stack
+void* EXT_MEM_TEXT _check_local_allocation(void* ret, unsigned int nbytes) {
     // Must check for zero because using nbytes > ~0x8000
     // will give ret = 0, and then it will trigger the next
     // if statement and try to free the null pointer
     if (ret == 0)
         return 0;
 
+#ifndef EBSP_EMULATOR
     // Check if it does not overwrite the current stack position
     // Plus 128 bytes of margin
     if ((uint32_t)ret + nbytes + 128 > (uint32_t)&ret) // <-- only epiphany
     {
         _free(coredata.local_malloc_base, ret);
-        ebsp_message(err_allocation, nbytes);
+        ebsp_message_deferred(err_allocation, nbytes);
         return 0;
     }
+#endif
     return ret;
 }
 
+void* EXT_MEM_TEXT ebsp_malloc(unsigned int nbytes) {
+    void* ret = _malloc(coredata.local_malloc_base, nbytes);
+    return _check_local_allocation(ret, nbytes);
+}
+
+// Allocates only in the given bank, or returns 0
+void* EXT_MEM_TEXT _malloc_in_bank(unsigned int nbytes, int bank) {
+    uint32_t first = coredata.local_bank_chunk[bank];
+    uint32_t last = coredata.local_bank_chunk[bank + 1];
+    if (first == last)
+        return 0;
+    void* ret = _malloc_in(coredata.local_malloc_base, nbytes, first, last);
+    return _check_local_allocation(ret, nbytes);
+}
+
+void* EXT_MEM_TEXT ebsp_malloc_bank(unsigned int nbytes, int bank) {
+    if (bank >= 0 && bank < LOCAL_BANKS) {
+        void* ret = _malloc_in_bank(nbytes, bank);
+        if (ret)
+            return ret;
+    }
+    return ebsp_malloc(nbytes);
+}
+
+// Allocates in a different bank than other when possible. Used for double
+// buffering, so that the DMA engine writes to one bank while the CPU reads
+// the other
+void* EXT_MEM_TEXT _malloc_apart(unsigned int nbytes, const void* other) {
+    int other_bank =
+        ((uintptr_t)other - local_store_start) / LOCAL_BANK_SIZE;
+    for (int i = 1; i < LOCAL_BANKS; i++) {
+        void* ret = _malloc_in_bank(nbytes, (other_bank + i) % LOCAL_BANKS);
+        if (ret)
+            return ret;
+    }
+    return ebsp_malloc(nbytes);
+}
+
 void EXT_MEM_TEXT ebsp_free(void* ptr) {
-    if (((unsigned)ptr) & 0xfff00000) {
+    if (ptr >= coredata.ext_arena_start && ptr < coredata.ext_arena_end) {
+        if (--coredata.ext_arena_live == 0)
+            coredata.ext_arena_cursor = coredata.ext_arena_start;
+    } else if (is_extmem_address(ptr)) {
+        if (ptr >= combuf->host_heap &&
+            ptr < combuf->host_heap + combuf->host_heap_size) {
+            ebsp_message_deferred(err_host_heap_free, ptr);
+            return;
+        }
+        if (((memory_object*)ptr - 1)->chunk_count == 0) {
+            ebsp_message_deferred(err_arena_free, ptr);
+            return;
+        }
         e_mutex_lock(0, 0, &coredata.malloc_mutex);
-        _free((void*)E_DYNMEM_ADDR, ptr);
+        _free(dynmem, ptr);
         e_mutex_unlock(0, 0, &coredata.malloc_mutex);
     } else {
         _free(coredata.local_malloc_base, ptr);
     }
 }
 
+// Scratch memory is a list of blocks from ebsp_malloc. Every block starts
+// with this header, and allocations move coredata.scratch_cursor through
+// the newest block
+typedef struct {
+    void* prev;
+    void* end;
+} ebsp_scratch_block;
+
+// Blocks are at least this large, so that small allocations
+// rarely need a new one
+#define SCRATCH_BLOCK_SIZE 1024
+
+// Start a new block with room for at least size bytes
+int EXT_MEM_TEXT _scratch_grow(uint32_t size) {
+    if (size < SCRATCH_BLOCK_SIZE)
+        size = SCRATCH_BLOCK_SIZE;
+    ebsp_scratch_block* block =
+        ebsp_malloc(sizeof(ebsp_scratch_block) + size);
+    if (block == 0)
+        return 0;
+    block->prev = coredata.scratch_block;
+    block->end = (void*)(block + 1) + size;
+    coredata.scratch_block = block;
+    coredata.scratch_cursor = block + 1;
+    coredata.scratch_end = block->end;
+    return 1;
+}
+
+// Return the newest block to ebsp_malloc
+void EXT_MEM_TEXT _scratch_shrink() {
+    ebsp_scratch_block* block = coredata.scratch_block;
+    ebsp_scratch_block* prev = block->prev;
+    coredata.scratch_block = prev;
+    coredata.scratch_end = prev ? prev->end : 0;
+    ebsp_free(block);
+}
+
+void* ebsp_scratch_mark() { return coredata.scratch_cursor; }
+
+void* ebsp_scratch_alloc(unsigned int nbytes) {
+    uint32_t size = chunk_roundup(nbytes);
+    uint32_t room =
+        (uintptr_t)coredata.scratch_end - (uintptr_t)coredata.scratch_cursor;
+    if (room < size && !_scratch_grow(size))
+        return 0;
+    void* ret = coredata.scratch_cursor;
+    coredata.scratch_cursor += size;
+    return ret;
+}
+
+void ebsp_scratch_release(void* mark) {
+    // Blocks that were started after the mark are not needed anymore
+    while (coredata.scratch_block &&
+           (mark < coredata.scratch_block + sizeof(ebsp_scratch_block) ||
+            mark > coredata.scratch_end))
+        _scratch_shrink();
+    coredata.scratch_cursor = mark;
+}
+
+// Called in bsp_end, so that the host can read the statistics of the local
+// heap with ebsp_get_malloc_stats
+void EXT_MEM_TEXT _write_malloc_stats() {
+    void* base = coredata.local_malloc_base;
+    malloc_counters* counters = get_malloc_counters(base);
+    ebsp_malloc_stats* stats = &combuf->local_malloc_stats[coredata.pid];
+    stats->live_bytes = counters->live_bytes;
+    stats->peak_bytes = counters->peak_bytes;
+    stats->allocs = counters->allocs;
+    stats->frees = counters->frees;
+    stats->failed = counters->failed;
+    stats->largest_free_run = _get_largest_free_run(base);
+    stats->free_list_bytes = counters->free_list_bytes;
+}
+
 // For debug purposes
 void EXT_MEM_TEXT print_malloc_info() {
-    uint32_t used, free;
-    _get_malloc_info(coredata.local_malloc_base, &used, &free);
-    ebsp_message("MALLOC STATE: %u Bytes used. %u Bytes free.",
-                 (unsigned int)used, (unsigned int)free);
+    uint32_t used, free, free_list;
+    _get_malloc_info(coredata.local_malloc_base, &used, &free, &free_list);
+    ebsp_message_deferred(
+        "MALLOC STATE: %u Bytes used. %u Bytes free. %u Bytes in free lists.",
+        (unsigned int)used, (unsigned int)free, (unsigned int)free_list);
 }
 
 void ebsp_memcpy(void* dest, const void* source, size_t nbytes) {
-    unsigned bits = (unsigned)dest | (unsigned)source;
+    unsigned bits = (uintptr_t)dest | (uintptr_t)source;
     if ((bits & 0x7) == 0) {
         // 8-byte aligned
         long long* dst = (long long*)dest;
@@ -0,0 +1,103 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "e_bsp_private.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+// ebsp_message and bsp_abort format on the core with vsnprintf, which
+// is large. They are in their own file so that programs that only
+// use ebsp_message_deferred do not link it
+
+void EXT_MEM_TEXT bsp_abort(const char* format, ...) {
+    // Because of the way these arguments work we can not
+    // simply call ebsp_message here
+    // so this function contains a copy of ebsp_message
+
+    // Lock mutex
+    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
+    // Write the message to a buffer
+    char buf[128];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(&buf[0], sizeof(buf), format, args);
+    va_end(args);
+    // Unlock mutex
+    e_mutex_unlock(0, 0, &coredata.ebsp_message_mutex);
+    if (length < 0)
+        length = 0;
+    if (length > (int)sizeof(buf) - 1)
+        length = sizeof(buf) - 1;
+    _log_write(buf, length, 0);
+
+    // Abort all cores and notify host
+    _write_syncstate(STATE_ABORT);
+#ifdef EBSP_EMULATOR
+    // The host stops the other cores when it sees STATE_ABORT
+    e_emu_halt();
+#else
+    // Experimental Epiphany feature that sends
+    // and abort signal to all cores
+    __asm__("MBKPT");
+    // Halt this core
+    __asm__("trap 3");
+#endif
+}
+
+void EXT_MEM_TEXT ebsp_message(const char* format, ...) {
+    // If format contains a %f then the printf family
+    // calls the function `cvt` which calls `dtoi_r`.
+    // `dtoi_r` calls Balloc (a private malloc used only
+    // within `dtoi_r`) which calls `calloc_r`
+    // which then calls `malloc_r`.
+    // The r means that the functions are reentrant.
+    // However `malloc_r` is not thread safe
+    // (where threads means cores in this case)
+    // and there will be crashes when multiple cores
+    // call it at the same time.
+    // Therefore, this printf is wrapped in a mutex
+    // even though at first hand it looks like it is
+    // not altering any global state.
+
+    // Only the formatting is done with the mutex locked,
+    // the log ring of every core has a single writer.
+
+    // Lock mutex
+    e_mutex_lock(0, 0, &coredata.ebsp_message_mutex);
+
+    // Write the message to a buffer
+    char buf[128];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(&buf[0], sizeof(buf), format, args);
+    va_end(args);
+
+    // Unlock mutex
+    e_mutex_unlock(0, 0, &coredata.ebsp_message_mutex);
+
+    if (length < 0)
+        length = 0;
+    if (length > (int)sizeof(buf) - 1)
+        length = sizeof(buf) - 1;
+    _log_write(buf, length, 0);
+}
+
@@ -34,38 +34,91 @@ void EXT_MEM_TEXT bsp_set_tagsize(int* tag_bytes) {
     *tag_bytes = coredata.tagsize;
 }
 
+// Takes a new chunk of the payload buffer and returns it with nbytes in
+// use, or 0 if the buffer is full. A payload larger than a chunk, or one
+// that only fits in the last bytes of the buffer, gets exactly the space
+// it needs and the current chunk is kept. The caller holds payload_mutex
+static char* _take_payload_chunk(unsigned int nbytes) {
+    unsigned int payload_offset = combuf->data_payloads.buffer_size;
+    unsigned int size = PAYLOAD_CHUNK_SIZE;
+    if (size < nbytes)
+        size = nbytes;
+
+    if (payload_offset + nbytes > MAX_PAYLOAD_SIZE)
+        return 0;
+    if (payload_offset + size > MAX_PAYLOAD_SIZE)
+        size = nbytes;
+    combuf->data_payloads.buffer_size += size;
+
+    char* ptr = &combuf->data_payloads.buf[payload_offset];
+    if (size != nbytes) {
+        coredata.payload_chunk = ptr;
+        coredata.payload_chunk_size = size;
+        coredata.payload_used = nbytes;
+    }
+    return ptr;
+}
+
+// Space for the payload of a bsp_put or bsp_send, or 0 if there is none.
+// Every core fills its own chunk of the payload buffer without locking,
+// so the cores only wait for each other when they need a new chunk
+void* _reserve_payload(unsigned int nbytes) {
+    nbytes = (nbytes + 7) & ~7;
+    if (coredata.payload_used + nbytes <= coredata.payload_chunk_size) {
+        void* ptr = coredata.payload_chunk + coredata.payload_used;
+        coredata.payload_used += nbytes;
+        return ptr;
+    }
+
+    // The mutex is NOT held while writing the payload itself
+    e_mutex_lock(0, 0, &coredata.payload_mutex);
+    void* ptr = _take_payload_chunk(nbytes);
+    e_mutex_unlock(0, 0, &coredata.payload_mutex);
+    return ptr;
+}
+
 void EXT_MEM_TEXT
 bsp_send(int pid, const void* tag, const void* payload, int nbytes) {
     unsigned int index;
-    unsigned int payload_offset;
-    unsigned int total_nbytes = coredata.tagsize + nbytes;
+    unsigned int total_nbytes = (coredata.tagsize + nbytes + 7) & ~7;
+    char* tag_ptr = 0;
 
     ebsp_message_queue* q =
         &combuf->message_queue[coredata.read_queue_index ^ 1];
 
+    if (coredata.payload_used + total_nbytes <= coredata.payload_chunk_size) {
+        tag_ptr = coredata.payload_chunk + coredata.payload_used;
+        coredata.payload_used += total_nbytes;
+    }
+
+    // The queue is shared by all cores. The slot is only taken when there
+    // is space for the payload, and a new chunk only when there is a slot
     e_mutex_lock(0, 0, &coredata.payload_mutex);
 
     index = q->count;
-    payload_offset = combuf->data_payloads.buffer_size;
 
-    if ((payload_offset + total_nbytes > MAX_PAYLOAD_SIZE) ||
-        (index >= MAX_MESSAGES)) {
+    if (index >= MAX_MESSAGES) {
         index = -1;
-        payload_offset = -1;
     } else {
-        q->count++;
-        combuf->data_payloads.buffer_size += total_nbytes;
+        if (tag_ptr == 0)
+            tag_ptr = _take_payload_chunk(total_nbytes);
+        if (tag_ptr == 0)
+            index = -1;
+        else
+            q->count++;
     }
 
     e_mutex_unlock(0, 0, &coredata.payload_mutex);
 
-    if (index == -1)
-        return ebsp_message(err_send_overflow);
+    if (index == -1) {
+        // Give back the space in the chunk, if any
+        if (tag_ptr != 0)
+            coredata.payload_used -= total_nbytes;
+        return ebsp_message_deferred(err_send_overflow);
+    }
 
     // We are now ready to save the request and payload
-    void* tag_ptr = &combuf->data_payloads.buf[payload_offset];
-    payload_offset += coredata.tagsize;
-    void* payload_ptr = &combuf->data_payloads.buf[payload_offset];
+    void* payload_ptr = tag_ptr + coredata.tagsize;
 
     q->message[index].pid = pid;
     q->message[index].tag = tag_ptr;
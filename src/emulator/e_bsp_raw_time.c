@@ -0,0 +1,44 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Emulator version of e_bsp_raw_time.s
+// The host clock is scaled to CLOCKSPEED, so timings are only indicative
+
+#define _GNU_SOURCE
+#include "e_bsp_private.h"
+#include <time.h>
+
+// Resets timer and returns old value, in clockcycles starting from 0
+unsigned int ebsp_raw_time() {
+    static struct timespec last;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double seconds =
+        (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) * 1.0e-9;
+    last = now;
+
+    double cycles = seconds * CLOCKSPEED;
+    if (cycles > (double)UINT32_MAX)
+        return UINT32_MAX;
+    return (unsigned int)cycles;
+}
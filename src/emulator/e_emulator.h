@@ -0,0 +1,83 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// State of the emulated Epiphany chip that is shared between the host
+// (e_hal.c) and every loaded copy of the core program (e_lib.c)
+//
+// Every core runs its own copy of the program, loaded as a shared object,
+// so that each core has private globals just like on the chip. Addresses
+// that point into such a copy are the `local` addresses of that core.
+// They are translated between cores by their offset in the copy.
+
+#pragma once
+#include <pthread.h>
+#include <stdint.h>
+
+#define E_EMU_ROWS 4
+#define E_EMU_COLS 4
+#define E_EMU_NCORES (E_EMU_ROWS * E_EMU_COLS)
+
+// Same numbering as the Parallella, where the first core has id 0x808
+#define E_EMU_FIRST_ROW 32
+#define E_EMU_FIRST_COL 8
+
+// Memory-mapped special registers of a core
+#define E_EMU_REGS_BASE 0xf0000
+#define E_EMU_REGS_SIZE 0x1000
+
+// Maximum number of queued DMA descriptors per core
+#define E_EMU_DMA_QUEUE_SIZE 256
+
+// Same layout as e_group_config_t in the emulated e-lib.h
+typedef struct {
+    unsigned group_rows;
+    unsigned group_cols;
+    unsigned core_row;
+    unsigned core_col;
+    unsigned group_row;
+    unsigned group_col;
+} e_emu_group_config_t;
+
+typedef struct {
+    // Address range of the copy of the program running on this core
+    uintptr_t image_start;
+    uintptr_t image_end;
+
+    unsigned regs[E_EMU_REGS_SIZE / sizeof(unsigned)];
+
+    // Descriptors queued on the DMA engine, only used by the core itself
+    void* dma_queue[E_EMU_DMA_QUEUE_SIZE];
+    unsigned dma_head;
+    unsigned dma_tail;
+
+    // Only used by the host
+    void* handle;
+    int (*main)();
+    int running;
+    pthread_t thread;
+} e_emu_core_t;
+
+typedef struct {
+    unsigned rows;
+    unsigned cols;
+    e_emu_core_t core[E_EMU_NCORES];
+} e_emu_platform_t;
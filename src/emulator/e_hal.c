@@ -0,0 +1,302 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Emulated e-hal and e-loader. Every core of the chip is a thread in the
+// host process, running its own copy of the core program. External memory
+// is an ordinary buffer shared by the host and all cores.
+
+#define _GNU_SOURCE
+#include <e-loader.h>
+#include "e_emulator.h"
+#include "ebsp_common.h"
+
+#include <dlfcn.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void* e_emu_extmem;
+
+static e_emu_platform_t platform;
+
+static e_emu_core_t* _core(unsigned row, unsigned col) {
+    return &platform.core[row * platform.cols + col];
+}
+
+// Translate an address as seen by core (row, col) to a host address
+static void* _core_address(unsigned row, unsigned col, off_t addr) {
+    e_emu_core_t* target = _core(row, col);
+    uintptr_t uaddr = (uintptr_t)addr;
+
+    if (uaddr >= E_EMU_REGS_BASE && uaddr < E_EMU_REGS_BASE + E_EMU_REGS_SIZE)
+        return &target->regs[(uaddr - E_EMU_REGS_BASE) / sizeof(unsigned)];
+
+    // A local address of any core refers to the same offset on the target
+    for (int i = 0; i < E_EMU_NCORES; i++) {
+        e_emu_core_t* core = &platform.core[i];
+        if (core->handle && uaddr >= core->image_start &&
+            uaddr < core->image_end)
+            return (void*)(uaddr - core->image_start + target->image_start);
+    }
+    return (void*)uaddr;
+}
+
+static void _stop_core(e_emu_core_t* core) {
+    if (core->running) {
+        pthread_cancel(core->thread);
+        pthread_join(core->thread, 0);
+        core->running = 0;
+    }
+    core->dma_head = 0;
+    core->dma_tail = 0;
+}
+
+static void _unload_core(e_emu_core_t* core) {
+    _stop_core(core);
+    if (core->handle) {
+        dlclose(core->handle);
+        core->handle = 0;
+    }
+}
+
+int e_init(char* hdf) {
+    platform.rows = E_EMU_ROWS;
+    platform.cols = E_EMU_COLS;
+    if (!e_emu_extmem)
+        e_emu_extmem = calloc(1, EXTMEM_SIZE);
+    return e_emu_extmem ? E_OK : E_ERR;
+}
+
+int e_finalize() {
+    // Cores write to each other's images, so stop all of them
+    // before the first image is unmapped
+    for (int i = 0; i < E_EMU_NCORES; i++)
+        _stop_core(&platform.core[i]);
+    for (int i = 0; i < E_EMU_NCORES; i++)
+        _unload_core(&platform.core[i]);
+    free(e_emu_extmem);
+    e_emu_extmem = 0;
+    return E_OK;
+}
+
+int e_reset_system() {
+    for (int i = 0; i < E_EMU_NCORES; i++)
+        _stop_core(&platform.core[i]);
+    return E_OK;
+}
+
+int e_get_platform_info(e_platform_t* p) {
+    p->objtype = E_EPI_PLATFORM;
+    p->row = E_EMU_FIRST_ROW;
+    p->col = E_EMU_FIRST_COL;
+    p->rows = platform.rows;
+    p->cols = platform.cols;
+    return E_OK;
+}
+
+int e_open(e_epiphany_t* dev, unsigned row, unsigned col, unsigned rows,
+           unsigned cols) {
+    if (row + rows > platform.rows || col + cols > platform.cols)
+        return E_ERR;
+    dev->objtype = E_EPI_GROUP;
+    dev->row = row;
+    dev->col = col;
+    dev->rows = rows;
+    dev->cols = cols;
+    dev->num_cores = rows * cols;
+    return E_OK;
+}
+
+int e_close(e_epiphany_t* dev) { return E_OK; }
+
+int e_reset_group(e_epiphany_t* dev) {
+    for (unsigned i = 0; i < dev->rows; i++)
+        for (unsigned j = 0; j < dev->cols; j++)
+            _stop_core(_core(dev->row + i, dev->col + j));
+    return E_OK;
+}
+
+static void* _core_thread(void* arg) {
+    e_emu_core_t* core = arg;
+    // Cores spin on shared memory without ever entering the kernel,
+    // so the host can only stop them with asynchronous cancellation
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, 0);
+    core->main();
+    return 0;
+}
+
+int e_start_group(e_epiphany_t* dev) {
+    for (unsigned i = 0; i < dev->rows; i++) {
+        for (unsigned j = 0; j < dev->cols; j++) {
+            e_emu_core_t* core = _core(dev->row + i, dev->col + j);
+            if (!core->handle || core->running)
+                continue;
+            if (pthread_create(&core->thread, 0, _core_thread, core) != 0)
+                return E_ERR;
+            core->running = 1;
+        }
+    }
+    return E_OK;
+}
+
+// Find the address range that the dynamic loader mapped for a program copy
+static int _find_image(struct dl_phdr_info* info, size_t size, void* data) {
+    e_emu_core_t* core = data;
+    struct link_map* map;
+    dlinfo(core->handle, RTLD_DI_LINKMAP, &map);
+    if (info->dlpi_addr != map->l_addr)
+        return 0;
+
+    core->image_start = UINTPTR_MAX;
+    core->image_end = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_LOAD)
+            continue;
+        uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+        uintptr_t end = start + phdr->p_memsz;
+        if (start < core->image_start)
+            core->image_start = start;
+        if (end > core->image_end)
+            core->image_end = end;
+    }
+    return 1;
+}
+
+// The dynamic loader maps a file only once, so every core gets
+// its own temporary copy of the program
+static void* _load_copy(const char* executable) {
+    FILE* src = fopen(executable, "rb");
+    if (!src)
+        return 0;
+
+    char path[] = "/tmp/ebsp_emu_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        fclose(src);
+        return 0;
+    }
+
+    char buf[4096];
+    size_t n;
+    int ok = 1;
+    while ((n = fread(buf, 1, sizeof(buf), src)) > 0)
+        if (write(fd, buf, n) != (ssize_t)n)
+            ok = 0;
+    fclose(src);
+    close(fd);
+
+    void* handle = ok ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : 0;
+    if (!handle && ok)
+        fprintf(stderr, "ERROR: %s\n", dlerror());
+    unlink(path);
+    return handle;
+}
+
+int e_load_group(char* executable, e_epiphany_t* dev, unsigned row,
+                 unsigned col, unsigned rows, unsigned cols, e_bool_t start) {
+    // Other workgroups keep running, but the cores of this one write to
+    // each other's images, so all of them stop before any is unloaded
+    for (unsigned i = 0; i < rows; i++)
+        for (unsigned j = 0; j < cols; j++)
+            _stop_core(_core(dev->row + row + i, dev->col + col + j));
+    for (unsigned i = 0; i < rows; i++) {
+        for (unsigned j = 0; j < cols; j++) {
+            e_emu_core_t* core = _core(dev->row + row + i, dev->col + col + j);
+            _unload_core(core);
+
+            core->handle = _load_copy(executable);
+            if (!core->handle)
+                return E_ERR;
+
+            core->main = dlsym(core->handle, "main");
+            e_emu_group_config_t* config = dlsym(core->handle, "e_group_config");
+            e_emu_platform_t** platform_ptr =
+                dlsym(core->handle, "e_emu_platform");
+            void** extmem_ptr = dlsym(core->handle, "e_emu_extmem");
+            if (!core->main || !config || !platform_ptr || !extmem_ptr) {
+                fprintf(stderr, "ERROR: %s is not an emulator program.\n",
+                        executable);
+                _unload_core(core);
+                return E_ERR;
+            }
+
+            config->group_rows = dev->rows;
+            config->group_cols = dev->cols;
+            config->core_row = row + i;
+            config->core_col = col + j;
+            config->group_row = E_EMU_FIRST_ROW + dev->row;
+            config->group_col = E_EMU_FIRST_COL + dev->col;
+            *platform_ptr = &platform;
+            *extmem_ptr = e_emu_extmem;
+
+            dl_iterate_phdr(_find_image, core);
+            memset(core->regs, 0, sizeof(core->regs));
+        }
+    }
+    if (start)
+        return e_start_group(dev);
+    return E_OK;
+}
+
+int e_alloc(e_mem_t* mbuf, off_t offset, size_t size) {
+    if (offset + size > EXTMEM_SIZE)
+        return E_ERR;
+    mbuf->objtype = E_EXT_MEM;
+    mbuf->phy_base = offset;
+    mbuf->map_size = size;
+    mbuf->base = e_emu_extmem + offset;
+    mbuf->ephy_base = (off_t)E_EXTMEM_ADDR + offset;
+    mbuf->emap_size = size;
+    return E_OK;
+}
+
+int e_free(e_mem_t* mbuf) { return E_OK; }
+
+ssize_t e_read(void* dev, unsigned row, unsigned col, off_t from_addr,
+               void* buf, size_t size) {
+    if (*(e_objtype_t*)dev == E_EXT_MEM) {
+        e_mem_t* mem = dev;
+        memcpy(buf, mem->base + from_addr, size);
+    } else {
+        e_epiphany_t* group = dev;
+        memcpy(buf, _core_address(group->row + row, group->col + col, from_addr),
+               size);
+    }
+    return size;
+}
+
+ssize_t e_write(void* dev, unsigned row, unsigned col, off_t to_addr,
+                const void* buf, size_t size) {
+    if (*(e_objtype_t*)dev == E_EXT_MEM) {
+        e_mem_t* mem = dev;
+        memcpy(mem->base + to_addr, buf, size);
+    } else {
+        e_epiphany_t* group = dev;
+        memcpy(_core_address(group->row + row, group->col + col, to_addr), buf,
+               size);
+    }
+    return size;
+}
@@ -0,0 +1,218 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Emulated e-lib. This file is linked into every core program that is
+// built for the emulator. The loader in e_hal.c fills in the variables
+// below for every copy of the program, one copy per core.
+
+#define _GNU_SOURCE
+#include <e-lib.h>
+#include "e_emulator.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+e_group_config_t e_group_config;
+e_emu_platform_t* e_emu_platform;
+void* e_emu_extmem;
+
+char e_emu_local_store[E_EMU_LOCAL_STORE_SIZE] __attribute__((aligned(8)));
+
+// Used by ebsp_dma_push to set the transfer size of a descriptor
+unsigned dma_data_size[8] = {E_DMA_DWORD, E_DMA_BYTE, E_DMA_HWORD,
+                             E_DMA_BYTE,  E_DMA_WORD, E_DMA_BYTE,
+                             E_DMA_HWORD, E_DMA_BYTE};
+
+// Coordinates are relative to the workgroup of this core
+static e_emu_core_t* _core(unsigned row, unsigned col) {
+    row += e_group_config.group_row - E_EMU_FIRST_ROW;
+    col += e_group_config.group_col - E_EMU_FIRST_COL;
+    return &e_emu_platform->core[row * e_emu_platform->cols + col];
+}
+
+static e_emu_core_t* _self() {
+    return _core(e_group_config.core_row, e_group_config.core_col);
+}
+
+e_coreid_t e_coreid_from_coords(unsigned row, unsigned col) {
+    return ((e_group_config.group_row + row) << 6) |
+           (e_group_config.group_col + col);
+}
+
+e_coreid_t e_get_coreid() {
+    return e_coreid_from_coords(e_group_config.core_row,
+                                e_group_config.core_col);
+}
+
+void* e_get_global_address(unsigned row, unsigned col, const void* ptr) {
+    uintptr_t addr = (uintptr_t)ptr;
+    e_emu_core_t* self = _self();
+    e_emu_core_t* target = _core(row, col);
+
+    if (addr >= self->image_start && addr < self->image_end)
+        return (void*)(addr - self->image_start + target->image_start);
+    if (addr >= E_EMU_REGS_BASE && addr < E_EMU_REGS_BASE + E_EMU_REGS_SIZE)
+        return &target->regs[(addr - E_EMU_REGS_BASE) / sizeof(unsigned)];
+
+    // Stack, heap and external memory are shared by all cores
+    return (void*)ptr;
+}
+
+unsigned e_reg_read(e_core_reg_id_t reg_id) {
+    return *(unsigned*)e_get_global_address(e_group_config.core_row,
+                                            e_group_config.core_col,
+                                            (void*)reg_id);
+}
+
+void e_reg_write(e_core_reg_id_t reg_id, unsigned val) {
+    *(unsigned*)e_get_global_address(e_group_config.core_row,
+                                     e_group_config.core_col,
+                                     (void*)reg_id) = val;
+}
+
+void e_irq_attach(e_irq_type_t irq, void (*handler)()) {}
+
+void e_irq_mask(e_irq_type_t irq, e_bool_t state) {}
+
+void e_irq_global_mask(e_bool_t state) {}
+
+//
+// Barrier and mutex, with the same algorithms as e-lib
+//
+
+void e_barrier_init(volatile e_barrier_t bar_array[],
+                    volatile e_barrier_t* tgt_bar_array[]) {
+    unsigned rows = e_group_config.group_rows;
+    unsigned cols = e_group_config.group_cols;
+    unsigned corenum =
+        e_group_config.core_row * cols + e_group_config.core_col;
+
+    for (unsigned i = 0; i < rows * cols; i++)
+        bar_array[i] = 0;
+
+    if (corenum == 0) {
+        for (unsigned i = 0; i < rows; i++)
+            for (unsigned j = 0; j < cols; j++)
+                tgt_bar_array[i * cols + j] =
+                    e_get_global_address(i, j, (void*)&bar_array[0]);
+    } else {
+        tgt_bar_array[0] =
+            e_get_global_address(0, 0, (void*)&bar_array[corenum]);
+    }
+}
+
+void e_barrier(volatile e_barrier_t* bar_array,
+               volatile e_barrier_t* tgt_bar_array[]) {
+    unsigned numcores = e_group_config.group_rows * e_group_config.group_cols;
+    unsigned corenum = e_group_config.core_row * e_group_config.group_cols +
+                       e_group_config.core_col;
+
+    // Make all writes of this superstep visible before signalling
+    __sync_synchronize();
+    if (corenum == 0) {
+        for (unsigned i = 1; i < numcores; i++)
+            while (bar_array[i] == 0)
+                sched_yield();
+        for (unsigned i = 1; i < numcores; i++)
+            bar_array[i] = 0;
+        __sync_synchronize();
+        for (unsigned i = 1; i < numcores; i++)
+            *(tgt_bar_array[i]) = 1;
+    } else {
+        *(tgt_bar_array[0]) = 1;
+        while (bar_array[0] == 0)
+            sched_yield();
+        bar_array[0] = 0;
+    }
+    __sync_synchronize();
+}
+
+void e_mutex_lock(unsigned row, unsigned col, e_mutex_t* mutex) {
+    e_mutex_t* m = e_get_global_address(row, col, mutex);
+    while (__sync_lock_test_and_set(m, 1))
+        sched_yield();
+}
+
+void e_mutex_unlock(unsigned row, unsigned col, e_mutex_t* mutex) {
+    e_mutex_t* m = e_get_global_address(row, col, mutex);
+    __sync_lock_release(m);
+}
+
+//
+// DMA engine
+//
+
+// Perform the transfer of a single descriptor. The strides are signed
+// 16-bit values, source in the lower and destination in the upper half.
+// At the end of every inner loop the outer stride is added instead of
+// the inner stride, as on the chip.
+static void _dma_transfer(e_dma_desc_t* desc) {
+    unsigned size = 1 << ((desc->config >> 5) & 3);
+    unsigned inner_count = desc->count & 0xffff;
+    unsigned outer_count = desc->count >> 16;
+    int src_inner = (int16_t)(desc->inner_stride & 0xffff);
+    int dst_inner = (int16_t)(desc->inner_stride >> 16);
+    int src_outer = (int16_t)(desc->outer_stride & 0xffff);
+    int dst_outer = (int16_t)(desc->outer_stride >> 16);
+    const char* src = desc->src_addr;
+    char* dst = desc->dst_addr;
+
+    for (unsigned i = 0; i < outer_count; i++) {
+        for (unsigned j = 0; j < inner_count; j++) {
+            memcpy(dst, src, size);
+            if (j + 1 < inner_count) {
+                src += src_inner;
+                dst += dst_inner;
+            }
+        }
+        src += src_outer;
+        dst += dst_outer;
+    }
+}
+
+int e_dma_start(e_dma_desc_t* descriptor, e_dma_id_t chan) {
+    e_emu_core_t* core = _self();
+    if (core->dma_tail - core->dma_head == E_EMU_DMA_QUEUE_SIZE)
+        e_emu_dma_wait(core->dma_queue[core->dma_head % E_EMU_DMA_QUEUE_SIZE]);
+    core->dma_queue[core->dma_tail % E_EMU_DMA_QUEUE_SIZE] = descriptor;
+    core->dma_tail++;
+    return 0;
+}
+
+void e_emu_dma_wait(e_dma_desc_t* descriptor) {
+    e_emu_core_t* core = _self();
+    while ((descriptor->config & E_DMA_ENABLE) &&
+           core->dma_head != core->dma_tail) {
+        e_dma_desc_t* desc =
+            core->dma_queue[core->dma_head % E_EMU_DMA_QUEUE_SIZE];
+        _dma_transfer(desc);
+        desc->config &= ~E_DMA_ENABLE;
+        core->dma_head++;
+    }
+}
+
+void e_emu_yield() { sched_yield(); }
+
+void e_emu_halt() {
+    pthread_exit(0);
+}
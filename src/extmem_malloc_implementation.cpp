@@ -25,6 +25,11 @@ see the files COPYING and COPYING.LESSER. If not, see
 //                        - Empty variable on the host
 //                        - On the Epiphany, puts function itself in external
 //                          memory
+//
+// With MALLOC_SIZE_CLASSES defined, small blocks are kept in a free list
+// per size when they are freed, and only large blocks use the bitmask
+// (see `make MALLOC_SIZE_CLASSES=1`). The host and the cores must agree
+// on this, because they share the heap in external memory.
 
 #include <stdint.h>
 
@@ -38,30 +43,83 @@ see the files COPYING and COPYING.LESSER. If not, see
 // This means every malloc will use up at least 16 bytes
 typedef struct {
     uint32_t chunk_count;
-    uint32_t padding;
+    // With MALLOC_SIZE_CLASSES, the offset from base of the slab of a small
+    // block, or of the next block in the free list when the block is free.
+    // It is 0 for blocks that are not in a slab
+    uint32_t next_free;
 } memory_object;
 
+// Counters that are updated by every call, see _get_largest_free_run for
+// the remaining statistic. Sizes are in whole chunks, including the
+// memory_object of every block
+typedef struct {
+    uint32_t live_bytes; // Allocated and not freed yet
+    uint32_t peak_bytes; // Maximum of live_bytes
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failed; // Allocations that returned 0
+    uint32_t free_list_bytes; // Free blocks in the lists, see below
+} malloc_counters;
+
+#define COUNTER_INTS 6
+
+#ifdef MALLOC_SIZE_CLASSES
+// Blocks of at most SMALL_CHUNKS_MAX chunks, including the memory_object,
+// go to the free list for their chunk count when they are freed. An empty
+// list is refilled with a slab: a run of about SLAB_CHUNKS chunks in the
+// bitmask that is cut into blocks. The memory_object at the start of a
+// slab holds its length and the number of its blocks that are allocated.
+// When the last one is freed, the slab goes back to the bitmask, so that
+// the free lists do not fragment the heap
+#define SMALL_CHUNKS_MAX 16
+#define SLAB_CHUNKS 32
+#define HEADER_INTS (2 + COUNTER_INTS + SMALL_CHUNKS_MAX)
+
+// A free block of a free list. It has at least two chunks, so that there
+// is room for the offset of the previous block in the list and of its slab
+typedef struct {
+    memory_object header;
+    uint32_t prev_free;
+    uint32_t slab;
+} free_block;
+#else
+#define HEADER_INTS (2 + COUNTER_INTS)
+#endif
+
 //
 // Layout of memory:
 //     base + 0x00: uint32_t total_bitmask_ints
-//     base + 0x04: uint32_t bitmasks[total_bitmask_ints]
+//     base + 0x04: uint32_t free_run_hint
+//     base + 0x08: malloc_counters counters
+//     base + 0x20: uint32_t free_lists[SMALL_CHUNKS_MAX] (MALLOC_SIZE_CLASSES)
+//     base + 4 * HEADER_INTS: uint32_t summary[total_summary_ints]
+//     base + 0x??: uint32_t bitmasks[total_bitmask_ints]
 //     base + 0x??: allocated memory
 //
-// Use get_alloc_base to get the ?? address
+// Use get_bitmasks and get_alloc_base to get the ?? addresses
+//
+// Every summary int holds the number of chunks in use in the next 32
+// bitmask ints, so that a search can skip 1024 chunks at once when they
+// are all in use or all free. free_run_hint is at least the length of the
+// longest run of free chunks. It is exact after a search that failed,
+// and reset to the number of chunks when chunks are freed.
 //
 
-// At base+4 there is first a long bitmask that indicates which chunks
+// After the header there is first a long bitmask that indicates which chunks
 // are currently in use. For n integers in the bitmask we can cover
 // 32*CHUNK_SIZE*n bytes of memory. But these n integers use 4*n space of
-// that as well. That means, if we have k bytes of memory, we need n so that
-// 4*n + 32*CHUNK_SIZE*n = k
-// Meaning n = k / (4+32*CHUNK_SIZE)
-#define compute_total_bitmask_ints(size) ((size - 4) / (4 + 32 * CHUNK_SIZE))
+// that as well, and their summary ints 4*n/32 which we round up to n.
+// That means, if we have k bytes of memory, we need n so that
+// 4*n + n + 32*CHUNK_SIZE*n = k
+// Meaning n = k / (5+32*CHUNK_SIZE)
+#define compute_total_bitmask_ints(size) \
+    ((size - 4 * HEADER_INTS - 4) / (5 + 32 * CHUNK_SIZE))
+#define compute_total_summary_ints(bitmask_ints) (((bitmask_ints) + 31) / 32)
 
 // The allocated memory starts at
-// chunk_roundup(base + 4 + total_bitmask_ints*4)
+// chunk_roundup(get_bitmasks(base) + total_bitmask_ints)
 // Round up to the next multiple of CHUNK_SIZE only if not a multiple yet
-inline uint32_t chunk_roundup(uint32_t a) {
+inline uintptr_t chunk_roundup(uintptr_t a) {
     // Compiler optimizes this function to (((a+7)>>3)<<3)
     // I also tested ((a+7) & ~7)
     // but this is 4 extra bytes of assembly and
@@ -79,28 +137,76 @@ inline uint32_t chunk_division(uint32_t a) {
 
 inline uint32_t get_bitmask_count(const void* base) { return *(uint32_t*)base; }
 
-inline uint32_t* get_bitmasks(const void* base) {
+inline uint32_t* get_free_run_hint(const void* base) {
     return (uint32_t*)(base + 4);
 }
 
-inline void* get_alloc_base(const void* base) {
-    return (void*)chunk_roundup((uint32_t)(base + 4 * (1 + *(uint32_t*)base)));
+inline malloc_counters* get_malloc_counters(const void* base) {
+    return (malloc_counters*)(base + 8);
 }
 
-// ebsp_ext_malloc wraps this in a mutex
-void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
-    nbytes += sizeof(memory_object);
-    uint32_t chunk_count = chunk_division(nbytes);
+inline uint32_t* get_summary(const void* base) {
+    return (uint32_t*)(base + 4 * HEADER_INTS);
+}
+
+inline uint32_t* get_bitmasks(const void* base) {
+    return get_summary(base) +
+           compute_total_summary_ints(get_bitmask_count(base));
+}
+
+inline void* get_alloc_base(const void* base) {
+    return (void*)chunk_roundup(
+        (uintptr_t)(get_bitmasks(base) + get_bitmask_count(base)));
+}
 
+// Marks a run of chunk_count chunks as used in the bitmask, within the
+// chunks first up to last. Returns the start of the run, or 0 when there is
+// no such run
+static memory_object* MALLOC_FUNCTION_PREFIX _malloc_chunks_in(
+    void* base, uint32_t chunk_count, uint32_t first, uint32_t last) {
     uint32_t total_bitmask_ints = get_bitmask_count(base);
     uint32_t* bitmasks = get_bitmasks(base);
+    uint32_t* summary = get_summary(base);
+    uint32_t* free_run_hint = get_free_run_hint(base);
+
+    // A previous search already found no run of this length
+    if (chunk_count > *free_run_hint)
+        return 0;
 
     // Search for a sequence of chunk_count zero bits
-    uint32_t start_mask = 0;
+    // The longest run before a reset is chunk_count - chunks_left
+    uint32_t start_mask = first / 32;
     uint32_t start_bit = 0;
     uint32_t chunks_left = chunk_count;
-    for (uint32_t i = 0; i < total_bitmask_ints; ++i) {
+    uint32_t longest_run = 0;
+    for (uint32_t i = first / 32; i < (last + 31) / 32; ++i) {
+        uint32_t masks = total_bitmask_ints - i;
+        if (masks > 32)
+            masks = 32;
+        if (i % 32 == 0 && 32 * i >= first && 32 * (i + masks) <= last) {
+            // Skip groups of 32 masks that are completely full or free
+            uint32_t used = summary[i / 32];
+            if (used == 32 * masks) {
+                if (chunk_count - chunks_left > longest_run)
+                    longest_run = chunk_count - chunks_left;
+                start_mask = i + masks;
+                start_bit = 0;
+                chunks_left = chunk_count; // reset
+                i += masks - 1;
+                continue;
+            } else if (used == 0 && chunks_left > 32 * masks) {
+                chunks_left -= 32 * masks;
+                i += masks - 1;
+                continue;
+            }
+        }
+
+        // Chunks outside of the range count as used
         uint32_t mask = bitmasks[i];
+        if (i == first / 32)
+            mask |= (1U << (first % 32)) - 1;
+        if (i == (last - 1) / 32 && last % 32 != 0)
+            mask |= ~((1U << (last % 32)) - 1);
         if (mask == 0) {
             // All 32 bits (chunks) of this mask are available
             // so we can handle them all at once
@@ -114,14 +220,19 @@ void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
         } else if (mask == -1) {
             // All 32 bits (chunks) are in use
             // So start at least AFTER this one
+            if (chunk_count - chunks_left > longest_run)
+                longest_run = chunk_count - chunks_left;
             start_mask = i + 1;
             start_bit = 0;
+            chunks_left = chunk_count; // reset
         } else {
             // Mask is not empty. We will need to parse all individual bits
             for (uint32_t j = 0; j < 32; ++j) {
                 if (mask & 1) {
                     // memory not available
                     // restart right after this chunk
+                    if (chunk_count - chunks_left > longest_run)
+                        longest_run = chunk_count - chunks_left;
                     start_mask = i;
                     start_bit = j + 1;
                     // wrap around if needed
@@ -137,95 +248,354 @@ void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
                 }
                 mask >>= 1;
             }
+            // Stop here, the next masks would move the start
+            if (chunks_left == 0)
+                break;
         }
     }
     // Unable to find free space
-    if (chunks_left != 0)
+    if (chunks_left != 0) {
+        if (chunk_count - chunks_left > longest_run)
+            longest_run = chunk_count - chunks_left;
+        if (first == 0 && last == 32 * total_bitmask_ints)
+            *free_run_hint = longest_run;
         return 0;
+    }
 
     // Fill all the bits that we found starting at start_mask,start_bit
     chunks_left = chunk_count;
     uint32_t bit = (1U << start_bit);
     for (uint32_t i = start_mask; chunks_left != 0; i++) {
         uint32_t mask = bitmasks[i];
-        for (; bit != 0 && chunks_left != 0; bit <<= 1) {
-            mask |= bit;
-            chunks_left--;
+        uint32_t filled = chunks_left;
+        if (bit == 1 && chunks_left >= 32) {
+            // The whole mask is in the run
+            mask = -1;
+            chunks_left -= 32;
+        } else {
+            for (; bit != 0 && chunks_left != 0; bit <<= 1) {
+                mask |= bit;
+                chunks_left--;
+            }
         }
         bitmasks[i] = mask;
+        summary[i / 32] += filled - chunks_left;
         bit = 1;
     }
 
-    // Bits have been filled. Now put a memory_object at the allocated space
-    void* ptr =
-        get_alloc_base(base) + CHUNK_SIZE * (start_mask * 32 + start_bit);
-    ((memory_object*)ptr)->chunk_count = chunk_count;
-    return ptr + sizeof(memory_object);
+    return (memory_object*)(get_alloc_base(base) +
+                            CHUNK_SIZE * (start_mask * 32 + start_bit));
 }
 
-void MALLOC_FUNCTION_PREFIX _free(void* base, void* ptr) {
-    ptr -= sizeof(memory_object);
+static memory_object* MALLOC_FUNCTION_PREFIX
+_malloc_chunks(void* base, uint32_t chunk_count) {
+    return _malloc_chunks_in(base, chunk_count, 0,
+                             32 * get_bitmask_count(base));
+}
+
+// Marks the chunks of ptr as free in the bitmask
+static void MALLOC_FUNCTION_PREFIX _free_chunks(void* base, void* ptr,
+                                                uint32_t chunk_count) {
     uint32_t chunk_start =
-        ((unsigned)(ptr - get_alloc_base(base))) / CHUNK_SIZE;
-    uint32_t chunk_count = ((memory_object*)ptr)->chunk_count;
+        ((uintptr_t)(ptr - get_alloc_base(base))) / CHUNK_SIZE;
 
     uint32_t* bitmasks = get_bitmasks(base);
+    uint32_t* summary = get_summary(base);
 
     uint32_t chunk_mask = chunk_start / 32;
     uint32_t bit = chunk_start % 32;
     for (; chunk_count != 0; ++chunk_mask) {
         uint32_t mask = bitmasks[chunk_mask];
-        for (; bit < 32 && chunk_count != 0; ++bit) {
-            mask &= ~(1U << bit);
-            chunk_count--;
+        uint32_t cleared = chunk_count;
+        if (bit == 0 && chunk_count >= 32) {
+            mask = 0;
+            chunk_count -= 32;
+        } else {
+            for (; bit < 32 && chunk_count != 0; ++bit) {
+                mask &= ~(1U << bit);
+                chunk_count--;
+            }
         }
         bitmasks[chunk_mask] = mask;
+        summary[chunk_mask / 32] -= cleared - chunk_count;
         bit = 0;
     }
+
+    // The freed chunks may join other free runs
+    *get_free_run_hint(base) = 32 * get_bitmask_count(base);
     return;
 }
 
+#ifdef MALLOC_SIZE_CLASSES
+inline uint32_t* get_free_lists(const void* base) {
+    return (uint32_t*)(base + 8 + 4 * COUNTER_INTS);
+}
+
+inline void push_free_block(void* base, free_block* block, uint32_t slab) {
+    uint32_t* free_list =
+        &get_free_lists(base)[block->header.chunk_count - 1];
+    uint32_t offset = (uintptr_t)((void*)block - base);
+    block->header.next_free = *free_list;
+    block->prev_free = 0;
+    block->slab = slab;
+    if (*free_list != 0)
+        ((free_block*)(base + *free_list))->prev_free = offset;
+    *free_list = offset;
+    get_malloc_counters(base)->free_list_bytes +=
+        block->header.chunk_count * CHUNK_SIZE;
+}
+
+inline void unlink_free_block(void* base, free_block* block) {
+    if (block->prev_free != 0)
+        ((free_block*)(base + block->prev_free))->header.next_free =
+            block->header.next_free;
+    else
+        get_free_lists(base)[block->header.chunk_count - 1] =
+            block->header.next_free;
+    if (block->header.next_free != 0)
+        ((free_block*)(base + block->header.next_free))->prev_free =
+            block->prev_free;
+    get_malloc_counters(base)->free_list_bytes -=
+        block->header.chunk_count * CHUNK_SIZE;
+}
+
+// Takes a slab from the bitmask and cuts it into blocks of chunk_count
+// chunks. Returns 0 when there is no room for a single block
+static int MALLOC_FUNCTION_PREFIX _refill_free_list(void* base,
+                                                    uint32_t chunk_count) {
+    uint32_t blocks = SLAB_CHUNKS / chunk_count;
+    memory_object* slab = _malloc_chunks(base, 1 + blocks * chunk_count);
+    if (slab == 0) {
+        blocks = 1;
+        slab = _malloc_chunks(base, 1 + chunk_count);
+        if (slab == 0)
+            return 0;
+    }
+    slab->chunk_count = 1 + blocks * chunk_count;
+    slab->next_free = 0;
+
+    // The lowest block ends up at the front of the list
+    uint32_t offset = (uintptr_t)((void*)slab - base);
+    for (uint32_t i = blocks; i-- > 0;) {
+        free_block* block =
+            (free_block*)((void*)slab + (1 + i * chunk_count) * CHUNK_SIZE);
+        block->header.chunk_count = chunk_count;
+        push_free_block(base, block, offset);
+    }
+    return 1;
+}
+
+// 1 when block is a block of a slab with allocated blocks. A pointer that
+// is not an allocated small block would corrupt the free lists
+static int MALLOC_FUNCTION_PREFIX _is_slab_block(void* base,
+                                                 memory_object* block) {
+    uint32_t chunk_count = block->chunk_count;
+    uint32_t offset = (uintptr_t)((void*)block - base);
+    uint32_t slab_offset = block->next_free;
+    if (chunk_count < 2 || chunk_count > SMALL_CHUNKS_MAX ||
+        slab_offset >= offset || (offset - slab_offset) % CHUNK_SIZE != 0)
+        return 0;
+    memory_object* slab = (memory_object*)(base + slab_offset);
+    uint32_t chunk = (offset - slab_offset) / CHUNK_SIZE;
+    return slab->next_free != 0 && (slab->chunk_count - 1) % chunk_count == 0 &&
+           (chunk - 1) % chunk_count == 0 &&
+           chunk + chunk_count <= slab->chunk_count;
+}
+
+// Puts a small block back in its free list, or returns its slab to the
+// bitmask when this was the last allocated block of it
+static void MALLOC_FUNCTION_PREFIX _free_small(void* base,
+                                               memory_object* block) {
+    memory_object* slab = (memory_object*)(base + block->next_free);
+    if (--slab->next_free != 0) {
+        push_free_block(base, (free_block*)block, block->next_free);
+        return;
+    }
+
+    // All other blocks of the slab are in the free list
+    uint32_t chunk_count = block->chunk_count;
+    for (uint32_t i = 1; i < slab->chunk_count; i += chunk_count) {
+        free_block* other = (free_block*)((void*)slab + i * CHUNK_SIZE);
+        if (other != (free_block*)block)
+            unlink_free_block(base, other);
+    }
+    _free_chunks(base, slab, slab->chunk_count);
+}
+#endif
+
+// Updates the counters after an allocation, and returns the block
+inline void* count_malloc(void* base, memory_object* block,
+                          uint32_t chunk_count) {
+    malloc_counters* counters = get_malloc_counters(base);
+    if (block == 0) {
+        counters->failed++;
+        return 0;
+    }
+    counters->allocs++;
+    counters->live_bytes += chunk_count * CHUNK_SIZE;
+    if (counters->live_bytes > counters->peak_bytes)
+        counters->peak_bytes = counters->live_bytes;
+    return (void*)block + sizeof(memory_object);
+}
+
+// ebsp_ext_malloc wraps this in a mutex
+void* MALLOC_FUNCTION_PREFIX _malloc(void* base, uint32_t nbytes) {
+    nbytes += sizeof(memory_object);
+    uint32_t chunk_count = chunk_division(nbytes);
+
+#ifdef MALLOC_SIZE_CLASSES
+    if (chunk_count <= SMALL_CHUNKS_MAX) {
+        // Room for the links of free_block
+        if (chunk_count < 2)
+            chunk_count = 2;
+        uint32_t* free_list = &get_free_lists(base)[chunk_count - 1];
+        if (*free_list == 0 && !_refill_free_list(base, chunk_count))
+            return count_malloc(base, 0, chunk_count);
+        free_block* block = (free_block*)(base + *free_list);
+        uint32_t slab = block->slab;
+        unlink_free_block(base, block);
+        ((memory_object*)(base + slab))->next_free++;
+        block->header.next_free = slab;
+        return count_malloc(base, &block->header, chunk_count);
+    }
+#endif
+
+    memory_object* ptr = _malloc_chunks(base, chunk_count);
+    if (ptr != 0) {
+        ptr->chunk_count = chunk_count;
+        ptr->next_free = 0;
+    }
+    return count_malloc(base, ptr, chunk_count);
+}
+
+// Like _malloc, but the block is within the chunks first up to last,
+// counted from get_alloc_base. It does not use the free lists, so its
+// blocks have no slab. A failure is not counted, because the caller can
+// try elsewhere
+void* MALLOC_FUNCTION_PREFIX
+_malloc_in(void* base, uint32_t nbytes, uint32_t first, uint32_t last) {
+    nbytes += sizeof(memory_object);
+    uint32_t chunk_count = chunk_division(nbytes);
+
+    memory_object* ptr = _malloc_chunks_in(base, chunk_count, first, last);
+    if (ptr == 0)
+        return 0;
+    ptr->chunk_count = chunk_count;
+    ptr->next_free = 0;
+    return count_malloc(base, ptr, chunk_count);
+}
+
+void MALLOC_FUNCTION_PREFIX _free(void* base, void* ptr) {
+    memory_object* block = (memory_object*)(ptr - sizeof(memory_object));
+
+    // Pointers into a block, such as the data after the header of a stream
+    // buffer, are ignored. Blocks are aligned, and other pointers usually
+    // find a chunk count of 0 here, as does a block of the ext arena of a
+    // core
+    if ((uintptr_t)ptr % CHUNK_SIZE != 0 || block->chunk_count == 0)
+        return;
+
+#ifdef MALLOC_SIZE_CLASSES
+    // Blocks of _malloc_in are not in a slab
+    if (block->next_free != 0 && !_is_slab_block(base, block))
+        return;
+#endif
+
+    malloc_counters* counters = get_malloc_counters(base);
+    counters->frees++;
+    counters->live_bytes -= block->chunk_count * CHUNK_SIZE;
+
+#ifdef MALLOC_SIZE_CLASSES
+    if (block->next_free != 0) {
+        _free_small(base, block);
+        return;
+    }
+#endif
+
+    _free_chunks(base, block, block->chunk_count);
+}
+
 // Initializes the malloc table
 void MALLOC_FUNCTION_PREFIX _init_malloc_state(void* base, uint32_t size) {
     uint32_t total_bitmask_ints = compute_total_bitmask_ints(size);
 
     // First we store the AMOUNT of bitmask ints
-    // Then there is the bitmask ints themselves
+    // Then the hint, which is every chunk, the counters and the free lists
+    // Then there is the summary ints and the bitmask ints themselves
     // Then there is the allocated memory
     uint32_t* ptr = (uint32_t*)base;
     *ptr++ = total_bitmask_ints;
-    while (total_bitmask_ints--)
+    *ptr++ = 32 * total_bitmask_ints;
+    for (uint32_t i = 2; i < HEADER_INTS; i++)
+        *ptr++ = 0;
+    uint32_t ints =
+        compute_total_summary_ints(total_bitmask_ints) + total_bitmask_ints;
+    while (ints--)
         *ptr++ = 0;
 }
 
-// For debug purposes
-void MALLOC_FUNCTION_PREFIX
-_get_malloc_info(void* base, uint32_t* used, uint32_t* free) {
+// Used and free bytes, from the summary ints. Free blocks in the lists of
+// MALLOC_SIZE_CLASSES are only available for blocks of their own size, so
+// they are counted in `free_list` instead of `free`
+void MALLOC_FUNCTION_PREFIX _get_malloc_info(void* base, uint32_t* used,
+                                             uint32_t* free,
+                                             uint32_t* free_list) {
     uint32_t total_bitmask_ints = get_bitmask_count(base);
-    uint32_t* bitmasks = get_bitmasks(base);
+    uint32_t* summary = get_summary(base);
 
+    uint32_t total_summary_ints =
+        compute_total_summary_ints(total_bitmask_ints);
     uint32_t bits_in_use = 0;
-    uint32_t bits_free = 0;
+    for (uint32_t i = 0; i < total_summary_ints; ++i)
+        bits_in_use += summary[i];
+
+    *free_list = get_malloc_counters(base)->free_list_bytes;
+    *used = bits_in_use * CHUNK_SIZE - *free_list;
+    *free = (32 * total_bitmask_ints - bits_in_use) * CHUNK_SIZE;
+}
+
+// Size in bytes of the longest run of free chunks in the bitmask, which
+// is the largest block that an allocation can still get. Blocks in the
+// free lists of MALLOC_SIZE_CLASSES are not counted, see _get_malloc_info
+uint32_t MALLOC_FUNCTION_PREFIX _get_largest_free_run(void* base) {
+    uint32_t total_bitmask_ints = get_bitmask_count(base);
+    uint32_t* summary = get_summary(base);
+    uint32_t* bitmasks = get_bitmasks(base);
+
+    uint32_t longest_run = 0;
+    uint32_t run = 0;
     for (uint32_t i = 0; i < total_bitmask_ints; ++i) {
-        uint32_t mask = bitmasks[i];
-        if (mask == 0) {
-            bits_free += 32;
-            continue;
-        } else if (mask == -1) {
-            bits_in_use += 32;
-            continue;
-        } else {
-            // Mask is not empty. We will need to parse all individual bits
-            for (uint32_t j = 0; j < 32; ++j) {
-                if (mask & 1) {
-                    bits_in_use++;
+        if (i % 32 == 0) {
+            // Groups of 32 masks that are completely full or free
+            uint32_t masks = total_bitmask_ints - i;
+            if (masks > 32)
+                masks = 32;
+            uint32_t used = summary[i / 32];
+            if (used == 32 * masks || used == 0) {
+                if (used == 0) {
+                    run += 32 * masks;
                 } else {
-                    bits_free++;
+                    if (run > longest_run)
+                        longest_run = run;
+                    run = 0;
                 }
-                mask >>= 1;
+                i += masks - 1;
+                continue;
+            }
+        }
+
+        uint32_t mask = bitmasks[i];
+        for (uint32_t bit = 0; bit < 32; ++bit) {
+            if (mask & (1U << bit)) {
+                if (run > longest_run)
+                    longest_run = run;
+                run = 0;
+            } else {
+                run++;
             }
         }
     }
-    *used = bits_in_use * CHUNK_SIZE;
-    *free = bits_free * CHUNK_SIZE;
+    if (run > longest_run)
+        longest_run = run;
+    return longest_run * CHUNK_SIZE;
 }
@@ -31,30 +31,31 @@ see the files COPYING and COPYING.LESSER. If not, see
 #define __USE_XOPEN2K
 #include <unistd.h> // For the function 'access' in bsp_init
 
-bsp_state_t state;
-
-int bsp_initialized = 0; // 1 after bsp_init, 2 after bsp_begin, 3 after ebsp_spmd, 0 after bsp_end
+// State of the workgroup of bsp_begin. After ebsp_group_begin,
+// state points to the selected workgroup instead
+bsp_state_t main_state;
+bsp_state_t* state = &main_state;
 
 int bsp_init(const char* _e_name, int argc, char** argv) {
-    if (bsp_initialized) {
+    if (state->initialized) {
         fprintf(stderr, "ERROR: bsp_init called when already initialized.\n");
         return 0;
     }
 
     // Get the path to the application and append the epiphany executable name
     init_application_path();
-    snprintf(state.e_fullpath, sizeof(state.e_fullpath), "%s%s",
-             state.e_directory, _e_name);
+    snprintf(state->e_fullpath, sizeof(state->e_fullpath), "%s%s",
+             state->e_directory, _e_name);
 
     // Check if the file exists
-    if (access(state.e_fullpath, R_OK) == -1) {
+    if (access(state->e_fullpath, R_OK) == -1) {
         fprintf(stderr, "ERROR: Could not find epiphany executable: %s\n",
-                state.e_fullpath);
+                state->e_fullpath);
         return 0;
     }
 
 #ifdef DEBUG
-    _read_elf(state.e_fullpath);
+    _read_elf(state->e_fullpath);
 #endif
 
     // Initialize the Epiphany system for the working with the host application
@@ -70,21 +71,23 @@ int bsp_init(const char* _e_name, int argc, char** argv) {
     }
 
     // Get information on the platform
-    if (e_get_platform_info(&state.platform) != E_OK) {
+    if (e_get_platform_info(&state->platform) != E_OK) {
         fprintf(stderr, "ERROR: Could not obtain platform information.\n");
         return 0;
     }
 
     // Obtain the number of processors from the platform information
-    state.nprocs = state.platform.rows * state.platform.cols;
+    state->nprocs = state->platform.rows * state->platform.cols;
+
+    _poll_set_default();
 
-    bsp_initialized = 1;
+    state->initialized = 1;
 
     return 1;
 }
 
 int bsp_begin(int nprocs) {
-    if (bsp_initialized != 1) {
+    if (state->initialized != 1) {
         fprintf(stderr, "ERROR: bsp_begin called twice or called before bsp_init\n");
         return 0;
     }
@@ -100,35 +103,35 @@ int bsp_begin(int nprocs) {
     }
 
     // TODO(*) non-rectangle
-    // state.rows = (nprocs / state.platform.rows);
-    // state.cols = nprocs / (nprocs / state.platform.rows);
-    state.rows = state.platform.rows;
-    state.cols = state.platform.cols;
+    // state->rows = (nprocs / state->platform.rows);
+    // state->cols = nprocs / (nprocs / state->platform.rows);
+    state->rows = state->platform.rows;
+    state->cols = state->platform.cols;
 
 #ifdef DEBUG
-    printf("(BSP) INFO: Making a workgroup of size %i x %i\n", state.rows,
-           state.cols);
+    printf("(BSP) INFO: Making a workgroup of size %i x %i\n", state->rows,
+           state->cols);
 #endif
 
-    state.nprocs_used = nprocs;
-    state.num_vars_registered = 0;
+    state->nprocs_used = nprocs;
+    state->num_vars_registered = 0;
 
     // Open the workgroup
-    if (e_open(&state.dev, 0, 0, state.rows, state.cols) != E_OK) {
+    if (e_open(&state->dev, 0, 0, state->rows, state->cols) != E_OK) {
         fprintf(stderr, "ERROR: Could not open workgroup.\n");
         return 0;
     }
 
-    if (e_reset_group(&state.dev) != E_OK) {
+    if (e_reset_group(&state->dev) != E_OK) {
         fprintf(stderr, "ERROR: Could not reset workgroup.\n");
         return 0;
     }
 
 // Load the e-binary
 #ifdef DEBUG
-    printf("(BSP) INFO: Loading: %s\n", state.e_fullpath);
+    printf("(BSP) INFO: Loading: %s\n", state->e_fullpath);
 #endif
-    if (e_load_group(state.e_fullpath, &state.dev, 0, 0, state.rows, state.cols,
+    if (e_load_group(state->e_fullpath, &state->dev, 0, 0, state->rows, state->cols,
                      E_FALSE) != E_OK) {
         fprintf(stderr, "ERROR: Could not load program in workgroup.\n");
         return 0;
@@ -136,94 +139,202 @@ int bsp_begin(int nprocs) {
 
     // e_alloc will mmap combuf and dynmem
     // The offset in external memory is equal to NEWLIB_SIZE
-    if (e_alloc(&state.emem, NEWLIB_SIZE, COMBUF_SIZE + DYNMEM_SIZE) != E_OK) {
+    if (e_alloc(&state->emem, NEWLIB_SIZE, COMBUF_SIZE + DYNMEM_SIZE) != E_OK) {
         fprintf(stderr, "ERROR: e_alloc failed in bspbegin.\n");
         return 0;
     }
-    state.host_combuf_addr = state.emem.base;
-    state.host_dynmem_addr = state.emem.base + COMBUF_SIZE;
+    state->host_combuf_addr = state->emem.base;
+    state->host_dynmem_addr = state->emem.base + COMBUF_SIZE;
+    state->dynmem_size = DYNMEM_SIZE;
 
     ebsp_malloc_init();
 
-    // Set initial buffer to zero so that it can be filled by messages
-    // before calling ebsp_spmd
-    memset(&state.combuf, 0, sizeof(ebsp_combuf));
+    memset(&state->combuf, 0, COMBUF_HEADER_SIZE);
+    _reset_message_queues();
 
-    bsp_initialized = 2;
+    state->initialized = 2;
 
     return 1;
 }
 
-int ebsp_spmd() {
-    if (bsp_initialized != 2) {
-        fprintf(stderr, "ERROR: ebsp_spmd called before bsp_begin\n");
+// Clear the message queues so that they can be filled by messages
+// before calling ebsp_spmd. The buffers themselves are never read
+// beyond their size, so only the sizes are reset
+void _reset_message_queues() {
+    state->host_combuf_addr->message_queue[0].count = 0;
+    state->host_combuf_addr->message_queue[1].count = 0;
+    state->host_combuf_addr->data_payloads.buffer_size = 0;
+    state->message_index = 0;
+}
+
+int _prepare_rerun() {
+    if (state->initialized != 3)
         return 0;
+
+    // Messages that were sent up in the previous run are dropped
+    _reset_message_queues();
+    state->rerun = 1;
+    state->initialized = 2;
+    return 1;
+}
+
+// Time that the host waits for the cores to go from bsp_end to
+// ebsp_next_run, in nanoseconds. Waiting starts again whenever a core parks
+#define PARK_TIMEOUT 10000000000LL
+
+// Wait until all cores are parked in ebsp_next_run
+static int _wait_parked() {
+    struct timespec ts_begin, ts_now;
+    clock_gettime(CLOCK_MONOTONIC, &ts_begin);
+    int parked_before = 0;
+
+    for (;;) {
+        if (!_read_extmem(&state->combuf, 0, COMBUF_POLL_SIZE)) {
+            fprintf(stderr, "ERROR: e_read ebsp_combuf failed in ebsp_spmd.\n");
+            return 0;
+        }
+
+        int parked = 0;
+        for (int i = 0; i < state->nprocs_used; i++) {
+            int8_t s = state->combuf.syncstate[i];
+            if (s == STATE_PARKED) {
+                parked++;
+            } else if (s != STATE_FINISH) {
+                fprintf(stderr, "ERROR: core %d is in state %d instead of "
+                                "waiting in ebsp_next_run.\n",
+                        i, s);
+                return 0;
+            }
+        }
+        if (parked == state->nprocs_used)
+            return 1;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts_now);
+        if (parked != parked_before) {
+            parked_before = parked;
+            ts_begin = ts_now;
+        }
+
+        // The cores park right after bsp_end, so this only times out
+        // when the program does not call ebsp_next_run
+        long long waited =
+            (ts_now.tv_sec - ts_begin.tv_sec) * 1000000000LL +
+            (ts_now.tv_nsec - ts_begin.tv_nsec);
+        if (waited > PARK_TIMEOUT) {
+            fprintf(stderr, "ERROR: ebsp_spmd called again, but the Epiphany"
+                            " program does not call ebsp_next_run.\n");
+            return 0;
+        }
+        _microsleep(10);
     }
+}
+
+int ebsp_spmd_start() {
+    // Run the loaded program again, see ebsp_next_run
+    if (state->initialized == 3)
+        _prepare_rerun();
+
+    if (state->initialized != 2) {
+        fprintf(stderr, "ERROR: ebsp_spmd_start called before bsp_begin\n");
+        return 0;
+    }
+
+    if (state->rerun && !_wait_parked())
+        return 0;
+
+    // The cores do not run, so the shared memory that was freed in the
+    // previous run can be released
+    _release_deferred_frees();
+    if (!_reserve_host_heap())
+        return 0;
 
     // Write stream structs to combuf + extmem
+    // Only cores that have streams get a descriptor table, and the tables
+    // of a previous run are replaced
 
     // Depcrecated streams:
     for (int p = 0; p < NPROCS; p++) {
-        int nbytes = state.combuf.n_streams[p] * sizeof(ebsp_stream_descriptor);
+        if (state->combuf.extmem_streams[p] != 0)
+            ebsp_free(_e_to_arm_pointer(state->combuf.extmem_streams[p]));
+        state->combuf.extmem_streams[p] = 0;
+        if (state->combuf.n_streams[p] == 0)
+            continue;
+        int nbytes = state->combuf.n_streams[p] * sizeof(ebsp_stream_descriptor);
         void* stream_descriptors = ebsp_ext_malloc(nbytes);
-        memcpy(stream_descriptors, state.buffered_streams[p], nbytes);
-        state.combuf.extmem_streams[p] = _arm_to_e_pointer(stream_descriptors);
+        memcpy(stream_descriptors, state->buffered_streams[p], nbytes);
+        state->combuf.extmem_streams[p] = _arm_to_e_pointer(stream_descriptors);
     }
 
     // New streams:
-    {
-        int nbytes = state.combuf.nstreams * sizeof(ebsp_stream_descriptor);
+    if (state->combuf.streams != 0)
+        ebsp_free(_e_to_arm_pointer(state->combuf.streams));
+    state->combuf.streams = 0;
+    if (state->combuf.nstreams != 0) {
+        int nbytes = state->combuf.nstreams * sizeof(ebsp_stream_descriptor);
         void* stream_descriptors = ebsp_ext_malloc(nbytes);
-        memcpy(stream_descriptors, state.shared_streams, nbytes);
-        state.combuf.streams = _arm_to_e_pointer(stream_descriptors);
+        memcpy(stream_descriptors, state->shared_streams, nbytes);
+        state->combuf.streams = _arm_to_e_pointer(stream_descriptors);
     }
 
-    // Write communication buffer containing nprocs,
-    // messages and tagsize
-    state.combuf.nprocs = state.nprocs_used;
-    for (int i = 0; i < state.nprocs; ++i)
-        state.combuf.syncstate[i] = STATE_INIT;
-    if (!_write_extmem(&state.combuf, 0, sizeof(ebsp_combuf))) {
+    // Write the start of the communication buffer containing nprocs,
+    // tagsize and the streams. The messages are already in extmem
+    state->combuf.nprocs = state->nprocs_used;
+    state->combuf.log_drop = (state->log_policy == EBSP_LOG_DROP);
+    state->combuf.ext_arena_size = state->ext_arena_size;
+    state->combuf.max_bsp_vars = state->max_bsp_vars;
+    state->combuf.put_buffer_size = state->put_buffer_size;
+    state->combuf.get_inbox_size = state->get_inbox_size;
+    state->combuf.host_heap =
+        state->host_heap ? _arm_to_e_pointer(state->host_heap) : 0;
+    state->combuf.host_heap_size = state->host_heap_size;
+    _log_reset();
+    memset(state->host_combuf_addr->local_malloc_stats, 0,
+           sizeof(state->host_combuf_addr->local_malloc_stats));
+    for (int i = 0; i < state->nprocs; ++i)
+        state->combuf.syncstate[i] = STATE_INIT;
+    if (!_write_extmem(&state->combuf, 0, COMBUF_HEADER_SIZE)) {
         fprintf(stderr, "ERROR: initial extmem write failed in ebsp_spmd.\n");
         return 0;
     }
 
     // Starting time
-    clock_gettime(CLOCK_MONOTONIC, &state.ts_start);
+    clock_gettime(CLOCK_MONOTONIC, &state->ts_start);
+    // Make sure that the first update is written
+    state->remote_time = -REMOTE_TIMER_RESOLUTION;
     _update_remote_timer();
 
-    // Start the program
+    // Start the program, or release the cores that are parked
+    // in ebsp_next_run. Cores that are not used are not parked.
     // Only in DEBUG mode:
     // The program will block on bsp_begin in state STATE_EREADY
     // untill we send a STATE_CONTINUE
-    if (e_start_group(&state.dev) != E_OK) {
+    if (state->rerun) {
+        for (int i = 0; i < state->nprocs_used; ++i)
+            _write_core_syncstate(i, STATE_CONTINUE);
+    } else if (e_start_group(&state->dev) != E_OK) {
         fprintf(stderr, "ERROR: e_start_group() failed.\n");
         return 0;
     }
 
-    // Every iteration we only have to read the start of the buffer
-    // because that is where the syncstate flags are located
-    // We have to read everything up to remotetimer (not included)
-    const int read_size = offsetof(ebsp_combuf, remotetimer);
-
 #ifdef DEBUG
+    const int read_size = COMBUF_POLL_SIZE;
+    int cores_started = state->rerun ? state->nprocs_used : state->nprocs;
     int cores_initialized;
     while (1) {
         _microsleep(1000); // 1 millisecond
 
         // Read the communication buffer
-        if (e_read(&state.emem, 0, 0, 0, &state.combuf, read_size) !=
-            read_size) {
+        if (!_read_extmem(&state->combuf, 0, read_size)) {
             fprintf(stderr, "ERROR: e_read ebsp_combuf failed in ebsp_spmd.\n");
             return 0;
         }
 
         // Check every core
         cores_initialized = 0;
-        for (int i = 0; i < state.nprocs; ++i)
-            if (state.combuf.syncstate[i] == STATE_EREADY)
+        for (int i = 0; i < state->nprocs; ++i)
+            if (state->combuf.syncstate[i] == STATE_EREADY)
                 ++cores_initialized;
-        if (cores_initialized == state.nprocs)
+        if (cores_initialized == cores_started)
             break;
     }
     printf("(BSP) DEBUG: All epiphany cores are ready for initialization.\n");
@@ -233,207 +344,286 @@ int ebsp_spmd() {
     _update_remote_timer();
 
     // Send start signal
-    for (int i = 0; i < state.nprocs; ++i)
+    for (int i = 0; i < state->nprocs; ++i)
         _write_core_syncstate(i, STATE_CONTINUE);
 #endif
 
-    int total_syncs = 0;
-    int extmem_corrupted = 0;
+    state->rerun = 0;
+    state->total_syncs = 0;
+    state->extmem_corrupted = 0;
+    state->poll_busy = 1;
+    state->spmd_result = 1;
+    _timeline_begin();
+
+#ifdef DEBUG
+    printf("(BSP) DEBUG: All epiphany cores initialized.\n");
+#endif
+
+    state->initialized = 4;
+
+    return 1;
+}
+
+// Read the final state of the program after all cores finished
+static void _spmd_finish() {
+    state->initialized = 3;
+    _release_deferred_frees();
+
+    _log_drain(1);
+
+    // Read the start of the communication buffer to get the final tagsize.
+    // The final messages are read from extmem directly
+    if (!_read_extmem(&state->combuf, 0, COMBUF_HEADER_SIZE)) {
+        fprintf(stderr,
+                "ERROR: e_read ebsp_combuf header failed in ebsp_spmd.\n");
+        state->spmd_result = 0;
+        return;
+    }
+
+#ifdef DEBUG
+    printf("(BSP) INFO: Program finished\n");
+#endif
+
+    if (state->end_callback)
+        state->end_callback();
+}
+
+int ebsp_spmd_poll() {
+    if (state->initialized == 3)
+        return 0;
+    if (state->initialized != 4) {
+        fprintf(stderr, "ERROR: ebsp_spmd_poll called before ebsp_spmd_start\n");
+        return 0;
+    }
+
+    // We only have to read the start of the buffer
+    // because that is where the syncstate and interrupt flags are located
+    const int read_size = COMBUF_POLL_SIZE;
     int run_counter = 0;
     int sync_counter = 0;
     int finish_counter = 0;
     int continue_counter = 0;
     int abort_counter = 0;
-
 #ifdef DEBUG
-    int iter = 0;
-    printf("(BSP) DEBUG: All epiphany cores initialized.\n");
+    static int iter = 0;
 #endif
 
-    for (;;) {
-        _update_remote_timer();
-        _microsleep(1); // 1000 is 1 millisecond
+    _update_remote_timer();
+    state->poll_busy = 0;
+
+    // Read the first part of the communication buffer
+    // that contains sync states and interrupts
+    if (!_read_extmem(&state->combuf, 0, read_size)) {
+        fprintf(stderr, "ERROR: e_read ebsp_combuf failed in ebsp_spmd.\n");
+        state->spmd_result = 0;
+        state->initialized = 3;
+        return 0;
+    }
 
-        // Read the first part of the communication buffer
-        // that contains sync states: read all up till coredata (not inclusive)
-        if (e_read(&state.emem, 0, 0, 0, &state.combuf, read_size) !=
-            read_size) {
-            fprintf(stderr, "ERROR: e_read ebsp_combuf failed in ebsp_spmd.\n");
-            return 0;
+    _timeline_update(state->total_syncs);
+
+    if (_log_drain(0))
+        state->poll_busy = 1;
+
+    // Check interrupts
+    for (int i = 0; i < state->nprocs; i++) {
+        if (state->combuf.interrupts[i] != 0) {
+            uint32_t ipend = state->combuf.interrupts[i];
+            fprintf(stderr, "WARNING: Interrupt occured on core %d: 0x%x\n",
+                    i, ipend);
+            // Reset
+            state->combuf.interrupts[i] = 0;
+            _write_extmem((void*)&state->combuf.interrupts[i],
+                          offsetof(ebsp_combuf, interrupts[i]),
+                          sizeof(uint16_t));
         }
+    }
 
-        // Check interrupts
-        for (int i = 0; i < state.nprocs; i++) {
-            if (state.combuf.interrupts[i] != 0) {
-                uint32_t ipend = state.combuf.interrupts[i];
-                fprintf(stderr, "WARNING: Interrupt occured on core %d: 0x%x\n",
-                        i, ipend);
-                // Reset
-                state.combuf.interrupts[i] = 0;
-                _write_extmem((void*)&state.combuf.interrupts[i],
-                              offsetof(ebsp_combuf, interrupts[i]),
-                              sizeof(uint16_t));
-            }
-        }
+    // Check sync states
+    for (int i = 0; i < state->nprocs; i++) {
+        switch (state->combuf.syncstate[i]) {
+        case STATE_INIT:
+            break;
 
-        // Check sync states
-        run_counter = 0;
-        sync_counter = 0;
-        finish_counter = 0;
-        continue_counter = 0;
-        abort_counter = 0;
-        for (int i = 0; i < state.nprocs; i++) {
-            switch (state.combuf.syncstate[i]) {
-            case STATE_INIT:
-                break;
-
-            case STATE_RUN:
-                run_counter++;
-                break;
-
-            case STATE_SYNC:
-                sync_counter++;
-                break;
-
-            case STATE_FINISH:
-                finish_counter++;
-                break;
-
-            case STATE_CONTINUE:
-                continue_counter++;
-                break;
-
-            case STATE_ABORT:
-                abort_counter++;
-                break;
-
-            case STATE_MESSAGE:
-                printf("$%02d: %s\n", i, state.combuf.msgbuf);
-                fflush(stdout);
-                // Reset flag to let epiphany core continue
-                _write_core_syncstate(i, STATE_CONTINUE);
-                break;
-
-            default:
-                extmem_corrupted++;
-                if (extmem_corrupted <= 32) // to avoid overflow
-                    fprintf(stderr, "ERROR: External memory corrupted."
-                                    " syncstate[%d] = %d.\n",
-                            i, state.combuf.syncstate[i]);
-                break;
-            }
+        case STATE_RUN:
+            run_counter++;
+            break;
+
+        case STATE_SYNC:
+            sync_counter++;
+            break;
+
+        case STATE_FINISH:
+        case STATE_PARKED:
+            finish_counter++;
+            break;
+
+        case STATE_CONTINUE:
+            continue_counter++;
+            break;
+
+        case STATE_ABORT:
+            abort_counter++;
+            break;
+
+        default:
+            state->extmem_corrupted++;
+            if (state->extmem_corrupted <= 32) // to avoid overflow
+                fprintf(stderr, "ERROR: External memory corrupted."
+                                " syncstate[%d] = %d.\n",
+                        i, state->combuf.syncstate[i]);
+            break;
         }
+    }
 
 #ifdef DEBUG
-        if (iter % 1000 == 0) {
-            printf("Iteration %5d run %02d - sync %02d - finish %02d - continue %02d\n",
-                   iter, run_counter, sync_counter, finish_counter, continue_counter);
-            // Get the `PROGRAM COUNTER` register (instruction pointer)
-            // to see what code is currently being executed
-            uint32_t pc[NPROCS];
-            for (int i = 0; i < state.nprocs_used; i++) {
-                int prow, pcol;
-                _get_p_coords(i, &prow, &pcol);
-                e_read(&state.dev, prow, pcol, E_REG_PC, &pc[i], sizeof(uint32_t));
-            }
-
-            printf("Current instruction for every core:");
-            for (int i = 0; i < state.nprocs_used; i++) {
-                if ((i % 4) == 0)
-                    printf("\n\t");
-                Symbol* sym = _get_symbol_by_addr((void*)pc[i]);
-                if (sym)
-                    printf(" %s+%p", sym->name, (void*)(pc[i] - sym->value));
-                else
-                    printf(" %p", (void*)pc[i]);
-            }
-            printf("\n");
+    if (iter % 1000 == 0) {
+        printf("Iteration %5d run %02d - sync %02d - finish %02d - continue %02d\n",
+               iter, run_counter, sync_counter, finish_counter, continue_counter);
+        // Get the `PROGRAM COUNTER` register (instruction pointer)
+        // to see what code is currently being executed
+        uint32_t pc[NPROCS];
+        for (int i = 0; i < state->nprocs_used; i++) {
+            int prow, pcol;
+            _get_p_coords(i, &prow, &pcol);
+            e_read(&state->dev, prow, pcol, E_REG_PC, &pc[i], sizeof(uint32_t));
+        }
 
-            fflush(stdout);
+        printf("Current instruction for every core:");
+        for (int i = 0; i < state->nprocs_used; i++) {
+            if ((i % 4) == 0)
+                printf("\n\t");
+            Symbol* sym = _get_symbol_by_addr((void*)pc[i]);
+            if (sym)
+                printf(" %s+%p", sym->name, (void*)(pc[i] - sym->value));
+            else
+                printf(" %p", (void*)pc[i]);
         }
-        ++iter;
+        printf("\n");
+
+        fflush(stdout);
+    }
+    ++iter;
 #endif
 
-        if (sync_counter == state.nprocs_used) {
-            ++total_syncs;
+    if (sync_counter == state->nprocs_used) {
+        ++state->total_syncs;
+        state->poll_busy = 1;
+        if (state->combuf.syncstate_ptr == 0)
+            _read_extmem(&state->combuf.syncstate_ptr,
+                         offsetof(ebsp_combuf, syncstate_ptr),
+                         sizeof(state->combuf.syncstate_ptr));
 #ifdef DEBUG
-            // This part of the sync (host side)
-            // usually does not crash so only one
-            // line of debug output is needed here
-            printf("(BSP) DEBUG: Sync %d\n", total_syncs);
+        // This part of the sync (host side)
+        // usually does not crash so only one
+        // line of debug output is needed here
+        printf("(BSP) DEBUG: Sync %d\n", state->total_syncs);
 #endif
-            // if call back, call and wait
-            if (state.sync_callback)
-                state.sync_callback();
-
-            // First reset the combuf
-            for (int i = 0; i < state.nprocs_used; i++)
-                state.combuf.syncstate[i] = STATE_CONTINUE;
-            _write_extmem(&state.combuf.syncstate,
-                          offsetof(ebsp_combuf, syncstate),
-                          NPROCS * sizeof(int));
-            // Now write it to all cores to continue their execution
-            for (int i = 0; i < state.nprocs_used; i++)
-                _write_core_syncstate(i, STATE_CONTINUE);
-        }
-        if (abort_counter != 0) {
-            printf("(BSP) ERROR: bsp_abort was called\n");
-            break;
+        // All cores wait, so all their messages come before the callback
+        _log_drain(1);
+        // All cores wait, so the host can use the shared heap
+        state->cores_waiting = 1;
+        _release_deferred_frees();
+        // if call back, call and wait
+        if (state->sync_callback) {
+            _timeline_record(EBSP_TIMELINE_CALLBACK, state->total_syncs - 1,
+                             -1);
+            state->sync_callback();
         }
-        if (finish_counter == state.nprocs_used)
-            break;
+        state->cores_waiting = 0;
+        _timeline_record(EBSP_TIMELINE_RELEASE, state->total_syncs - 1, -1);
+
+        // First reset the combuf
+        for (int i = 0; i < state->nprocs_used; i++)
+            state->combuf.syncstate[i] = STATE_CONTINUE;
+        _write_extmem(&state->combuf.syncstate,
+                      offsetof(ebsp_combuf, syncstate),
+                      NPROCS * sizeof(int8_t));
+        // Now write it to all cores to continue their execution
+        for (int i = 0; i < state->nprocs_used; i++)
+            _write_core_syncstate(i, STATE_CONTINUE);
     }
-    // Read the communication buffer
-    // to get final messages from the program
-    if (e_read(&state.emem, 0, 0, 0, &state.combuf, sizeof(ebsp_combuf)) !=
-        sizeof(ebsp_combuf)) {
-        fprintf(stderr,
-                "ERROR: e_read full ebsp_combuf failed in ebsp_spmd.\n");
+    if (abort_counter != 0) {
+        _log_drain(1);
+        printf("(BSP) ERROR: bsp_abort was called\n");
+        state->spmd_result = 0;
+        _spmd_finish();
+        return 0;
+    }
+    if (finish_counter == state->nprocs_used) {
+        _spmd_finish();
         return 0;
     }
 
-#ifdef DEBUG
-    printf("(BSP) INFO: Program finished\n");
-#endif
-
-    if (state.end_callback)
-        state.end_callback();
-
-    bsp_initialized = 3;
+    return 1;
+}
 
-    if (abort_counter != 0)
+int ebsp_spmd_wait() {
+    if (state->initialized == 4) {
+        _poll_begin();
+        do {
+            _poll_wait(state->poll_busy);
+        } while (ebsp_spmd_poll());
+        _poll_end();
+    }
+    if (state->initialized != 3) {
+        fprintf(stderr, "ERROR: ebsp_spmd_wait called before ebsp_spmd_start\n");
         return 0;
+    }
+    return state->spmd_result;
+}
 
-    return 1;
+int ebsp_spmd() {
+    if (!ebsp_spmd_start())
+        return 0;
+    return ebsp_spmd_wait();
 }
 
 int bsp_end() {
-    if (bsp_initialized == 0) {
+    if (state->initialized == 0) {
         fprintf(stderr,
                 "ERROR: bsp_end called when bsp was not initialized.\n");
         return 0;
     }
+    if (state->initialized == 4) {
+        fprintf(stderr,
+                "ERROR: bsp_end called while the Epiphany program is running.\n");
+        return 0;
+    }
+
+    if (!_groups_end())
+        return 0;
 
 #ifdef DEBUG
-    if (state.e_symbols)
-        free(state.e_symbols);
-    state.e_symbols = 0;
+    if (state->e_symbols)
+        free(state->e_symbols);
+    state->e_symbols = 0;
 #endif
 
-    if (bsp_initialized >= 2)
-        e_free(&state.emem);
+    // Let cores that are parked in ebsp_next_run finish
+    if (state->initialized == 3 || state->rerun)
+        for (int i = 0; i < state->nprocs_used; i++)
+            _write_core_syncstate(i, STATE_FINISH);
+
+    if (state->initialized >= 2)
+        e_free(&state->emem);
+
+    _log_end();
 
     if (E_OK != e_finalize()) {
         fprintf(stderr, "ERROR: Could not finalize the Epiphany connection.\n");
         return 0;
     }
 
-    memset(&state, 0, sizeof(state));
+    free(state->timeline);
+    free(state->deferred_frees);
+
+    memset(state, 0, sizeof(bsp_state_t));
 
-    bsp_initialized = 0;
+    state->initialized = 0;
 
     return 1;
 }
 
-int bsp_nprocs() { return state.nprocs; }
+int bsp_nprocs() { return state->nprocs; }
 
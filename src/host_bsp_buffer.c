@@ -26,16 +26,16 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include <string.h>
 
 
-extern bsp_state_t state;
+extern bsp_state_t* state;
 #define MINIMUM_CHUNK_SIZE (4 * sizeof(int))
 
 void* bsp_stream_create(int stream_size, int token_size,
                          const void* initial_data) {
     if (token_size < MINIMUM_CHUNK_SIZE) {
-        printf("ERROR: minimum token size is %i bytes\n", MINIMUM_CHUNK_SIZE);
+        printf("ERROR: minimum token size is %i bytes\n", (int)MINIMUM_CHUNK_SIZE);
         return 0;
     }
-    if (state.combuf.nstreams == MAX_N_STREAMS) {
+    if (state->combuf.nstreams == MAX_N_STREAMS) {
         printf("ERROR: Reached limit of %d streams.\n", MAX_N_STREAMS);
         return 0;
     }
@@ -56,8 +56,8 @@ void* bsp_stream_create(int stream_size, int token_size,
     }
 
     // 2) copy the data to extmem, inserting headers
-    unsigned dst_cursor = (unsigned)extmem_buffer;
-    unsigned src_cursor = (unsigned)initial_data;
+    uintptr_t dst_cursor = (uintptr_t)extmem_buffer;
+    uintptr_t src_cursor = (uintptr_t)initial_data;
 
     if (initial_data) {
         int current_chunksize = token_size;
@@ -104,8 +104,8 @@ void* bsp_stream_create(int stream_size, int token_size,
     x.current_buffer = NULL;
     x.next_buffer = NULL;
 
-    state.shared_streams[state.combuf.nstreams] = x;
-    state.combuf.nstreams++;
+    state->shared_streams[state->combuf.nstreams] = x;
+    state->combuf.nstreams++;
 
     return extmem_buffer;
 }
@@ -26,13 +26,13 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include <string.h>
 
 
-extern bsp_state_t state;
+extern bsp_state_t* state;
 #define MINIMUM_CHUNK_SIZE (4 * sizeof(int))
 
 void ebsp_create_down_stream(const void* src, int dst_core_id, int nbytes,
                              int max_chunksize) {
     if (max_chunksize < MINIMUM_CHUNK_SIZE) {
-        printf("ERROR: minimum chunk size is %i bytes\n", MINIMUM_CHUNK_SIZE);
+        printf("ERROR: minimum chunk size is %i bytes\n", (int)MINIMUM_CHUNK_SIZE);
         return;
     }
 
@@ -53,8 +53,8 @@ void ebsp_create_down_stream(const void* src, int dst_core_id, int nbytes,
     }
 
     // 2) copy the data to extmem, inserting headers
-    unsigned dst_cursor = (unsigned)extmem_in_buffer;
-    unsigned src_cursor = (unsigned)src;
+    uintptr_t dst_cursor = (uintptr_t)extmem_in_buffer;
+    uintptr_t src_cursor = (uintptr_t)src;
 
     int current_chunksize = max_chunksize;
     int last_chunksize = 0;
@@ -104,7 +104,7 @@ void ebsp_create_down_stream_raw(const void* src, int dst_core_id, int nbytes,
 
 void* ebsp_create_up_stream(int src_core_id, int nbytes, int max_chunksize) {
     if (max_chunksize < MINIMUM_CHUNK_SIZE) {
-        printf("ERROR: minimum chunk size is %i bytes\n", MINIMUM_CHUNK_SIZE);
+        printf("ERROR: minimum chunk size is %i bytes\n", (int)MINIMUM_CHUNK_SIZE);
         return NULL;
     }
 
@@ -121,11 +121,11 @@ void* ebsp_create_up_stream(int src_core_id, int nbytes, int max_chunksize) {
     return extmem_out_buffer;
 }
 
-// add ebsp_stream_descriptor to state.buffered_streams, update state.n_streams
+// add ebsp_stream_descriptor to state->buffered_streams, update state->n_streams
 void _ebsp_add_stream(int core_id, void* extmem_buffer, int nbytes,
                       int max_chunksize, int is_down_stream) {
-    if (state.combuf.n_streams[core_id] == MAX_N_STREAMS) {
-        printf("ERROR: state.combuf.n_streams >= MAX_N_STREAMS\n");
+    if (state->combuf.n_streams[core_id] == MAX_N_STREAMS) {
+        printf("ERROR: state->combuf.n_streams >= MAX_N_STREAMS\n");
         return;
     }
 
@@ -140,6 +140,6 @@ void _ebsp_add_stream(int core_id, void* extmem_buffer, int nbytes,
     x.next_buffer = NULL;
     x.is_down_stream = is_down_stream;
 
-    state.buffered_streams[core_id][state.combuf.n_streams[core_id]] = x;
-    state.combuf.n_streams[core_id]++;
+    state->buffered_streams[core_id][state->combuf.n_streams[core_id]] = x;
+    state->combuf.n_streams[core_id]++;
 }
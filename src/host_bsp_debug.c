@@ -35,8 +35,8 @@ Symbol* _get_symbol_by_addr(void* addr);
 Symbol* _get_symbol_by_name(const char* symbol);
 
 void _read_elf(const char* filename) {
-    state.e_symbols = 0;
-    state.num_symbols = 0;
+    state->e_symbols = 0;
+    state->num_symbols = 0;
 
     FILE* file = fopen(filename, "r");
     
@@ -101,22 +101,22 @@ void _parse_symbols(char* buffer, size_t fsize, Elf32_Shdr* shdr,
     Elf32_Sym* symbol = (Elf32_Sym*)&buffer[symtab->sh_offset];
 
     // First count the number of symbols that we want to save
-    state.num_symbols = 0;
+    state->num_symbols = 0;
     for (size_t i = 0; i < count; i++) {
         if (ELF32_ST_BIND(symbol[i].st_info) == STB_GLOBAL &&
             symbol[i].st_shndx != SHN_ABS) {
-            state.num_symbols++;
+            state->num_symbols++;
         }
     }
 
     // Now save them in the array
-    state.e_symbols = (Symbol*)malloc(state.num_symbols * sizeof(Symbol));
+    state->e_symbols = (Symbol*)malloc(state->num_symbols * sizeof(Symbol));
     size_t j = 0;
     for (size_t i = 0; i < count; i++) {
         if (ELF32_ST_BIND(symbol[i].st_info) != STB_GLOBAL ||
             symbol[i].st_shndx == SHN_ABS)
             continue;
-        Symbol* sym = &state.e_symbols[j++];
+        Symbol* sym = &state->e_symbols[j++];
         sym->index = i;
         sym->value = symbol[i].st_value;
         sym->size = symbol[i].st_size;
@@ -129,19 +129,19 @@ void _parse_symbols(char* buffer, size_t fsize, Elf32_Shdr* shdr,
 }
 
 Symbol* _get_symbol_by_addr(void* addr) {
-    for (size_t i = 0; i < state.num_symbols; i++) {
-        if (state.e_symbols[i].value <= ((unsigned int)addr) &&
-            ((unsigned int)addr) < state.e_symbols[i].value + state.e_symbols[i].size) {
-            return &state.e_symbols[i];
+    for (size_t i = 0; i < state->num_symbols; i++) {
+        if (state->e_symbols[i].value <= ((unsigned int)addr) &&
+            ((unsigned int)addr) < state->e_symbols[i].value + state->e_symbols[i].size) {
+            return &state->e_symbols[i];
         }
     }
     return 0;
 }
 
 Symbol* _get_symbol_by_name(const char* symbol) {
-    for (size_t i = 0; i < state.num_symbols; i++) {
-        if (!strncmp(state.e_symbols[i].name, symbol, sizeof(state.e_symbols[i].name))) {
-            return &state.e_symbols[i];
+    for (size_t i = 0; i < state->num_symbols; i++) {
+        if (!strncmp(state->e_symbols[i].name, symbol, sizeof(state->e_symbols[i].name))) {
+            return &state->e_symbols[i];
         }
     }
     return 0;
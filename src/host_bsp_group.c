@@ -0,0 +1,219 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "host_bsp_private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <e-loader.h>
+
+// Workgroups of ebsp_group_begin. Every workgroup has its own state,
+// and `state` points to the selected one
+static bsp_state_t* groups[NPROCS];
+static int ngroups = 0;
+static int cores_in_groups = 0;
+
+// The workgroup that a core belongs to, or -1 if it is free
+static int core_group[NPROCS];
+
+int ebsp_group_begin(const char* e_name, int row, int col, int rows,
+                     int cols) {
+    // Restored when loading the workgroup fails
+    bsp_state_t* selected = state;
+
+    if (ngroups == 0 && main_state.initialized != 1) {
+        fprintf(stderr, "ERROR: ebsp_group_begin called before bsp_init or "
+                        "after bsp_begin\n");
+        return -1;
+    }
+    if (rows < 1 || cols < 1 || row < 0 || col < 0 ||
+        row + rows > main_state.platform.rows ||
+        col + cols > main_state.platform.cols) {
+        fprintf(stderr, "ERROR: ebsp_group_begin called with a rectangle of "
+                        "%d x %d cores at (%d,%d) outside the chip.\n",
+                rows, cols, row, col);
+        return -1;
+    }
+
+    if (ngroups == 0) {
+        for (int i = 0; i < NPROCS; i++)
+            core_group[i] = -1;
+
+        // The external memory is shared by all workgroups. The default
+        // combuf contains the list of workgroups for bsp_begin on the cores
+        if (e_alloc(&main_state.emem, NEWLIB_SIZE, COMBUF_SIZE + DYNMEM_SIZE) !=
+            E_OK) {
+            fprintf(stderr, "ERROR: e_alloc failed in ebsp_group_begin.\n");
+            return -1;
+        }
+        main_state.host_combuf_addr = main_state.emem.base;
+        main_state.host_dynmem_addr = main_state.emem.base + COMBUF_SIZE;
+        main_state.dynmem_size = DYNMEM_SIZE;
+        state = &main_state;
+        ebsp_malloc_init();
+        memset(main_state.host_combuf_addr, 0, COMBUF_HEADER_SIZE);
+        main_state.initialized = 2;
+    }
+
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            int g = core_group[(row + i) * main_state.platform.cols + col + j];
+            if (g != -1) {
+                fprintf(stderr, "ERROR: ebsp_group_begin called with core "
+                                "(%d,%d), which is in workgroup %d.\n",
+                        row + i, col + j, g);
+                return -1;
+            }
+        }
+    }
+
+    bsp_state_t* group = calloc(1, sizeof(bsp_state_t));
+    if (!group) {
+        fprintf(stderr, "ERROR: could not allocate workgroup state.\n");
+        return -1;
+    }
+    memcpy(group->e_directory, main_state.e_directory,
+           sizeof(group->e_directory));
+    snprintf(group->e_fullpath, sizeof(group->e_fullpath), "%s%s",
+             group->e_directory, e_name);
+    if (access(group->e_fullpath, R_OK) == -1) {
+        fprintf(stderr, "ERROR: Could not find epiphany executable: %s\n",
+                group->e_fullpath);
+        free(group);
+        return -1;
+    }
+    group->platform = main_state.platform;
+    group->emem = main_state.emem;
+    group->poll_policy = main_state.poll_policy;
+    group->log_policy = main_state.log_policy;
+    group->ext_arena_size = main_state.ext_arena_size;
+    group->max_bsp_vars = main_state.max_bsp_vars;
+    group->put_buffer_size = main_state.put_buffer_size;
+    group->get_inbox_size = main_state.get_inbox_size;
+    group->host_heap_size = main_state.host_heap_size;
+    group->rows = rows;
+    group->cols = cols;
+    group->nprocs = rows * cols;
+    group->nprocs_used = rows * cols;
+
+    // The combuf and ext_malloc memory of the workgroup
+    state = &main_state;
+    unsigned size = COMBUF_SIZE + rows * cols * GROUP_DYNMEM_PER_CORE;
+    void* slice = ebsp_ext_malloc(size);
+    if (!slice) {
+        fprintf(stderr, "ERROR: not enough external memory for another "
+                        "workgroup.\n");
+        free(group);
+        state = selected;
+        return -1;
+    }
+    group->host_combuf_addr = slice;
+    group->host_dynmem_addr = (char*)slice + COMBUF_SIZE;
+    group->dynmem_size = rows * cols * GROUP_DYNMEM_PER_CORE;
+
+    state = group;
+    if (e_open(&group->dev, row, col, rows, cols) != E_OK) {
+        fprintf(stderr, "ERROR: Could not open workgroup.\n");
+        goto fail;
+    }
+    if (e_reset_group(&group->dev) != E_OK) {
+        fprintf(stderr, "ERROR: Could not reset workgroup.\n");
+        goto fail;
+    }
+    if (e_load_group(group->e_fullpath, &group->dev, 0, 0, rows, cols,
+                     E_FALSE) != E_OK) {
+        fprintf(stderr, "ERROR: Could not load program in workgroup.\n");
+        goto fail;
+    }
+
+    ebsp_malloc_init();
+    memset(&group->combuf, 0, COMBUF_HEADER_SIZE);
+    _reset_message_queues();
+    group->initialized = 2;
+
+    // Add the cores to the list of workgroups. They read it in bsp_begin,
+    // so it must be complete before ebsp_spmd_start
+    ebsp_combuf* list = main_state.host_combuf_addr;
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            unsigned prow = main_state.platform.row + row + i;
+            unsigned pcol = main_state.platform.col + col + j;
+            list->group_coreid[cores_in_groups] = (prow << 6) | pcol;
+            list->group_combuf[cores_in_groups] = _arm_to_e_pointer(slice);
+            cores_in_groups++;
+            core_group[(row + i) * main_state.platform.cols + col + j] =
+                ngroups;
+        }
+    }
+
+    // The new workgroup stays selected, see ebsp_group_begin in host_bsp.h
+    groups[ngroups] = group;
+    return ngroups++;
+
+fail:
+    state = &main_state;
+    ebsp_free(slice);
+    free(group);
+    state = selected;
+    return -1;
+}
+
+int ebsp_group_select(int group) {
+    if (group < 0 || group >= ngroups) {
+        fprintf(stderr, "ERROR: ebsp_group_select called with unknown "
+                        "workgroup %d.\n",
+                group);
+        return 0;
+    }
+    state = groups[group];
+    return 1;
+}
+
+int _groups_end() {
+    for (int g = 0; g < ngroups; g++) {
+        if (groups[g]->initialized == 4) {
+            fprintf(stderr, "ERROR: bsp_end called while the Epiphany program "
+                            "of workgroup %d is running.\n",
+                    g);
+            return 0;
+        }
+    }
+
+    for (int g = 0; g < ngroups; g++) {
+        state = groups[g];
+        // Let cores that are parked in ebsp_next_run finish
+        if (state->initialized == 3 || state->rerun)
+            for (int i = 0; i < state->nprocs_used; i++)
+                _write_core_syncstate(i, STATE_FINISH);
+        e_close(&state->dev);
+        free(state->timeline);
+        free(state->deferred_frees);
+        free(state);
+        groups[g] = 0;
+    }
+    ngroups = 0;
+    cores_in_groups = 0;
+    state = &main_state;
+    return 1;
+}
@@ -0,0 +1,367 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "host_bsp_private.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Largest record in a log ring, see _log_write on the cores
+#define LOG_RECORD_MAX (sizeof(ebsp_log_header) + LOG_MESSAGE_SIZE)
+
+// Mapping of the programs of the cores in external memory, which contain
+// the EXT_MEM_RO strings. Only mapped when such a string is used
+static e_mem_t program_mem;
+static int program_mem_mapped = 0;
+
+int ebsp_set_log_policy(ebsp_log_policy policy) {
+    if (policy != EBSP_LOG_BLOCK && policy != EBSP_LOG_DROP) {
+        fprintf(stderr, "ERROR: unknown log policy %d.\n", policy);
+        return 0;
+    }
+    state->log_policy = policy;
+    return 1;
+}
+
+// Empty the log rings before the cores start
+void _log_reset() {
+    for (int i = 0; i < NPROCS; i++) {
+        ebsp_log_ring* ring = &state->host_combuf_addr->log[i];
+        ring->head = 0;
+        ring->tail = 0;
+        ring->epoch = 0;
+        ring->dropped = 0;
+        state->log_dropped[i] = 0;
+    }
+}
+
+// Read a format string of ebsp_message_deferred from the memory of a core.
+// Returns 0 when it can not be read
+static const char* _log_format_string(int pid, uintptr_t address) {
+    ebsp_log_format* entry =
+        &state->log_formats[(address / sizeof(void*)) % LOG_FORMAT_CACHE];
+    if (entry->address == address)
+        return entry->text;
+    entry->address = 0;
+
+    if (address - E_EXTMEM_ADDR < NEWLIB_SIZE) {
+        if (!program_mem_mapped) {
+            if (e_alloc(&program_mem, 0, NEWLIB_SIZE) != E_OK) {
+                fprintf(stderr, "ERROR: Could not map the programs of the "
+                                "cores in external memory.\n");
+                return 0;
+            }
+            program_mem_mapped = 1;
+        }
+        uintptr_t offset = address - E_EXTMEM_ADDR;
+        size_t size = LOG_MESSAGE_SIZE;
+        if (size > NEWLIB_SIZE - offset)
+            size = NEWLIB_SIZE - offset;
+        memcpy(entry->text, (char*)program_mem.base + offset, size);
+        entry->text[size - 1] = 0;
+    } else if (!ebsp_read(pid, (off_t)address, entry->text,
+                          LOG_MESSAGE_SIZE)) {
+        return 0;
+    }
+
+    entry->text[LOG_MESSAGE_SIZE - 1] = 0;
+    entry->address = address;
+    return entry->text;
+}
+
+// Next argument of type `type` in a record, at a multiple of its size.
+// See ebsp_message_deferred on the cores
+#define LOG_ARG(type, value)                                                   \
+    {                                                                          \
+        size = (size + sizeof(type) - 1) & ~(sizeof(type) - 1);                \
+        if (size + sizeof(type) > length)                                      \
+            goto done;                                                         \
+        memcpy(&value, &data[size], sizeof(type));                             \
+        size += sizeof(type);                                                  \
+    }
+
+// Append the output of snprintf to text, up to LOG_MESSAGE_SIZE - 1
+// characters
+#define LOG_PRINT(...)                                                         \
+    {                                                                          \
+        int printed = snprintf(&text[n], LOG_MESSAGE_SIZE - n, __VA_ARGS__);   \
+        if (printed > 0)                                                       \
+            n += printed;                                                      \
+        if (n > LOG_MESSAGE_SIZE - 1)                                          \
+            n = LOG_MESSAGE_SIZE - 1;                                          \
+    }
+
+// Format a record of ebsp_message_deferred
+static void _log_format(int pid, const char* data, uint32_t length,
+                        char* text) {
+    size_t n = 0;
+    text[0] = 0;
+
+    uintptr_t address = 0;
+    uint32_t size = 0;
+    LOG_ARG(uintptr_t, address);
+
+    const char* format = _log_format_string(pid, address);
+    if (!format) {
+        LOG_PRINT("(format string at %p could not be read)", (void*)address);
+        return;
+    }
+
+    for (const char* f = format; *f && n < LOG_MESSAGE_SIZE - 1; f++) {
+        if (*f != '%') {
+            text[n++] = *f;
+            continue;
+        }
+
+        // The conversion is printed with the length modifier of the
+        // type that the core stored, `*` is replaced by its value
+        char spec[32] = "%";
+        size_t k = 1;
+        int longs = 0;
+        int sized = 0;
+        for (f++;; f++) {
+            char c = *f;
+            if (c == '*') {
+                int value = 0;
+                LOG_ARG(int, value);
+                if (k < sizeof(spec) - 16)
+                    k += snprintf(&spec[k], 12, "%d", value);
+            } else if (c == 'l') {
+                longs++;
+            } else if (c == 'j') {
+                longs = 2;
+            } else if (c == 'z' || c == 't') {
+                sized = 1;
+            } else if (c == 'L') {
+                continue;
+            } else if ((c >= '0' && c <= '9') || c == '-' || c == '+' ||
+                       c == ' ' || c == '#' || c == '.' || c == 'h') {
+                if (k < sizeof(spec) - 16)
+                    spec[k++] = c;
+            } else {
+                break;
+            }
+        }
+
+        char conversion = *f;
+        if (conversion == 0)
+            break;
+        if (conversion == '%') {
+            text[n++] = '%';
+            continue;
+        }
+
+        switch (conversion) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (longs >= 2) {
+                long long value = 0;
+                LOG_ARG(long long, value);
+                spec[k++] = 'l';
+                spec[k++] = 'l';
+                spec[k++] = conversion;
+                spec[k] = 0;
+                LOG_PRINT(spec, value);
+            } else if (longs == 1) {
+                long value = 0;
+                LOG_ARG(long, value);
+                spec[k++] = 'l';
+                spec[k++] = conversion;
+                spec[k] = 0;
+                LOG_PRINT(spec, value);
+            } else if (sized) {
+                size_t value = 0;
+                LOG_ARG(size_t, value);
+                spec[k++] = 'z';
+                spec[k++] = conversion;
+                spec[k] = 0;
+                LOG_PRINT(spec, value);
+            } else {
+                int value = 0;
+                LOG_ARG(int, value);
+                spec[k++] = conversion;
+                spec[k] = 0;
+                LOG_PRINT(spec, value);
+            }
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            double value = 0;
+            LOG_ARG(double, value);
+            spec[k++] = conversion;
+            spec[k] = 0;
+            LOG_PRINT(spec, value);
+            break;
+        }
+        case 'p': {
+            void* value = 0;
+            LOG_ARG(void*, value);
+            spec[k++] = conversion;
+            spec[k] = 0;
+            LOG_PRINT(spec, value);
+            break;
+        }
+        case 'n': {
+            void* value = 0;
+            LOG_ARG(void*, value);
+            break;
+        }
+        case 's': {
+            // The core copied the string, and data ends with a zero
+            if (size >= length)
+                goto done;
+            const char* value = &data[size];
+            size += strlen(value) + 1;
+            spec[k++] = conversion;
+            spec[k] = 0;
+            LOG_PRINT(spec, value);
+            break;
+        }
+        default:
+            spec[k++] = conversion;
+            spec[k] = 0;
+            LOG_PRINT("%s", spec);
+            break;
+        }
+    }
+
+done:
+    text[n] = 0;
+}
+
+// Print the messages in the log rings of the cores.
+// A message is only printed when every running core has passed the barrier
+// after it, so that the messages of a superstep come before those of the
+// next one, and are sorted by pid within a superstep. This needs the
+// syncstates of the last poll. With `flush`, or when a core might be
+// waiting for room in its ring, all messages are printed.
+// Returns the number of printed messages
+int _log_drain(int flush) {
+    ebsp_combuf* cb = state->host_combuf_addr;
+
+    // The epochs are read before the heads, so every message
+    // of an epoch before `bound` is in the rings
+    uint32_t bound = UINT32_MAX;
+    if (!flush) {
+        for (int i = 0; i < state->nprocs_used; i++) {
+            int8_t s = state->combuf.syncstate[i];
+            if (s == STATE_FINISH || s == STATE_PARKED || s == STATE_ABORT)
+                continue;
+            uint32_t epoch = *(volatile uint32_t*)&cb->log[i].epoch;
+            if (epoch < bound)
+                bound = epoch;
+        }
+    }
+    __sync_synchronize();
+
+    uint32_t head[NPROCS];
+    uint32_t tail[NPROCS];
+    for (int i = 0; i < state->nprocs_used; i++) {
+        head[i] = *(volatile uint32_t*)&cb->log[i].head;
+        tail[i] = cb->log[i].tail;
+        if (head[i] - tail[i] > LOG_RING_SIZE - LOG_RECORD_MAX)
+            bound = UINT32_MAX;
+    }
+    __sync_synchronize();
+
+    int printed = 0;
+    for (;;) {
+        // Oldest message of all cores
+        int pid = -1;
+        uint32_t epoch = bound;
+        for (int i = 0; i < state->nprocs_used; i++) {
+            if (tail[i] == head[i])
+                continue;
+            ebsp_log_header* header =
+                (ebsp_log_header*)&cb->log[i].buf[tail[i] % LOG_RING_SIZE];
+            if (header->epoch < epoch) {
+                pid = i;
+                epoch = header->epoch;
+            }
+        }
+        if (pid == -1)
+            break;
+
+        ebsp_log_ring* ring = &cb->log[pid];
+        uint32_t offset = tail[pid] % LOG_RING_SIZE;
+        uint32_t length = ((ebsp_log_header*)&ring->buf[offset])->length;
+        uint32_t deferred = length & LOG_DEFERRED_BIT;
+        length &= ~LOG_DEFERRED_BIT;
+        if (length > LOG_MESSAGE_SIZE)
+            length = LOG_MESSAGE_SIZE;
+        offset = (offset + sizeof(ebsp_log_header)) % LOG_RING_SIZE;
+
+        // Aligned copy of the record, with room for a terminating zero
+        uint64_t record[LOG_MESSAGE_SIZE / sizeof(uint64_t) + 1];
+        char* data = (char*)record;
+        for (uint32_t j = 0; j < length; j++)
+            data[j] = ring->buf[(offset + j) % LOG_RING_SIZE];
+        data[length] = 0;
+
+        if (deferred) {
+            char text[LOG_MESSAGE_SIZE];
+            _log_format(pid, data, length, text);
+            printf("$%02d: %s\n", pid, text);
+        } else {
+            printf("$%02d: %s\n", pid, data);
+        }
+
+        tail[pid] += (sizeof(ebsp_log_header) + length + 7) & ~7;
+        printed++;
+    }
+
+    if (printed)
+        fflush(stdout);
+
+    for (int i = 0; i < state->nprocs_used; i++) {
+        if (cb->log[i].tail != tail[i])
+            cb->log[i].tail = tail[i];
+
+        uint32_t dropped = *(volatile uint32_t*)&cb->log[i].dropped;
+        if (dropped != state->log_dropped[i]) {
+            fprintf(stderr, "WARNING: %u messages of core %d were dropped.\n",
+                    dropped - state->log_dropped[i], i);
+            state->log_dropped[i] = dropped;
+        }
+    }
+
+    return printed;
+}
+
+// Release the mapping of the programs, called by bsp_end
+void _log_end() {
+    if (program_mem_mapped) {
+        e_free(&program_mem);
+        program_mem_mapped = 0;
+    }
+}
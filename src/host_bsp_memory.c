@@ -25,27 +25,176 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include "host_bsp_private.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 //
 // Host version of ebsp memory allocation functions
-// Can only be used when epiphany cores are not running
+// The cores protect the shared heap with a mutex that the host can not take,
+// so while they run the host uses its own heap, see ebsp_set_host_heap_size
 //
 
-// Should be called once on host after state.host_dynmem_addr has been set
+// Should be called once on host after state->host_dynmem_addr has been set
 void ebsp_malloc_init() {
-    return _init_malloc_state(state.host_dynmem_addr, DYNMEM_SIZE);
+    state->host_heap = 0;
+    state->cores_waiting = 0;
+    state->deferred_free_count = 0;
+    return _init_malloc_state(state->host_dynmem_addr, state->dynmem_size);
+}
+
+// The cores do not use the shared heap when they are not running, or
+// when they all wait for the host in ebsp_host_sync
+static int _shared_heap_usable() {
+    return state->initialized != 4 || state->cores_waiting;
+}
+
+static int _in_host_heap(void* ptr) {
+    return state->host_heap != 0 && ptr >= state->host_heap &&
+           ptr < state->host_heap + state->host_heap_size;
+}
+
+// Called in ebsp_spmd_start, when the cores do not run yet
+int _reserve_host_heap() {
+    if (state->host_heap != 0 || state->host_heap_size == 0)
+        return 1;
+    void* heap = _malloc(state->host_dynmem_addr, state->host_heap_size);
+    if (heap == 0) {
+        fprintf(stderr, "ERROR: not enough external memory for a host heap "
+                        "of %u bytes.\n",
+                state->host_heap_size);
+        return 0;
+    }
+    _init_malloc_state(heap, state->host_heap_size);
+    state->host_heap = heap;
+    return 1;
+}
+
+void _release_deferred_frees() {
+    for (int i = 0; i < state->deferred_free_count; i++)
+        _free(state->host_dynmem_addr, state->deferred_frees[i]);
+    state->deferred_free_count = 0;
 }
 
 void* ebsp_ext_malloc(unsigned int nbytes) {
-    return _malloc(state.host_dynmem_addr, nbytes);
+    if (_shared_heap_usable())
+        return _malloc(state->host_dynmem_addr, nbytes);
+    if (state->host_heap == 0) {
+        fprintf(stderr, "ERROR: ebsp_ext_malloc called while the Epiphany "
+                        "program is running, without a host heap.\n");
+        return 0;
+    }
+    return _malloc(state->host_heap, nbytes);
+}
+
+void ebsp_free(void* ptr) {
+    // Blocks of the ext arena of a core have a chunk count of 0
+    if (((memory_object*)ptr - 1)->chunk_count == 0) {
+        fprintf(stderr, "ERROR: ebsp_free called on memory of the ext arena "
+                        "of a core.\n");
+        return;
+    }
+    if (_in_host_heap(ptr)) {
+        _free(state->host_heap, ptr);
+    } else if (_shared_heap_usable()) {
+        _free(state->host_dynmem_addr, ptr);
+    } else {
+        if (state->deferred_free_count == state->deferred_free_capacity) {
+            int capacity = 2 * state->deferred_free_capacity + 16;
+            void** frees =
+                realloc(state->deferred_frees, capacity * sizeof(void*));
+            if (frees == 0) {
+                fprintf(stderr, "ERROR: could not defer ebsp_free.\n");
+                return;
+            }
+            state->deferred_frees = frees;
+            state->deferred_free_capacity = capacity;
+        }
+        state->deferred_frees[state->deferred_free_count++] = ptr;
+    }
 }
 
-void ebsp_free(void* ptr) { return _free(state.host_dynmem_addr, ptr); }
+int ebsp_set_ext_arena_size(unsigned int nbytes) {
+    if (nbytes > GROUP_DYNMEM_PER_CORE) {
+        fprintf(stderr,
+                "ERROR: arena of %u bytes is larger than the %u bytes of "
+                "external memory per core.\n",
+                nbytes, (unsigned)GROUP_DYNMEM_PER_CORE);
+        return 0;
+    }
+    state->ext_arena_size = nbytes;
+    return 1;
+}
+
+int ebsp_set_max_bsp_vars(unsigned int count) {
+    // The cores link the slots with 16-bit numbers
+    if (count == 0 || count > 0xffff) {
+        fprintf(stderr, "ERROR: ebsp_set_max_bsp_vars called with %u.\n",
+                count);
+        return 0;
+    }
+    state->max_bsp_vars = count;
+    return 1;
+}
+
+int ebsp_set_put_buffer_size(unsigned int nbytes) {
+    if (nbytes > MAX_PUT_BUFFER_SIZE) {
+        fprintf(stderr,
+                "ERROR: put buffer of %u bytes is larger than the maximum "
+                "of %u bytes.\n",
+                nbytes, (unsigned)MAX_PUT_BUFFER_SIZE);
+        return 0;
+    }
+    state->put_buffer_size = nbytes;
+    return 1;
+}
+
+int ebsp_set_get_inbox_size(unsigned int requests) {
+    if (requests > MAX_GET_INBOX_SIZE) {
+        fprintf(stderr,
+                "ERROR: get inbox of %u requests is larger than the maximum "
+                "of %u requests.\n",
+                requests, (unsigned)MAX_GET_INBOX_SIZE);
+        return 0;
+    }
+    state->get_inbox_size = requests;
+    return 1;
+}
+
+int ebsp_set_host_heap_size(unsigned int nbytes) {
+    if (state->host_heap != 0) {
+        fprintf(stderr, "ERROR: ebsp_set_host_heap_size called after the "
+                        "host heap was reserved.\n");
+        return 0;
+    }
+    state->host_heap_size = nbytes;
+    return 1;
+}
+
+int ebsp_get_malloc_stats(int pid, ebsp_malloc_stats* stats) {
+    if (pid < 0 || pid >= state->nprocs) {
+        fprintf(stderr, "ERROR: ebsp_get_malloc_stats called with pid %d.\n",
+                pid);
+        return 0;
+    }
+    *stats = state->host_combuf_addr->local_malloc_stats[pid];
+    return 1;
+}
+
+void ebsp_get_ext_malloc_stats(ebsp_malloc_stats* stats) {
+    void* base = state->host_dynmem_addr;
+    malloc_counters* counters = get_malloc_counters(base);
+    stats->live_bytes = counters->live_bytes;
+    stats->peak_bytes = counters->peak_bytes;
+    stats->allocs = counters->allocs;
+    stats->frees = counters->frees;
+    stats->failed = counters->failed;
+    stats->largest_free_run = _get_largest_free_run(base);
+    stats->free_list_bytes = counters->free_list_bytes;
+}
 
 int ebsp_write(int pid, void* src, off_t dst, int size) {
     int prow, pcol;
     _get_p_coords(pid, &prow, &pcol);
-    if (e_write(&state.dev, prow, pcol, dst, src, size) != size) {
+    if (e_write(&state->dev, prow, pcol, dst, src, size) != size) {
         fprintf(stderr,
                 "ERROR: e_write(dev,%d,%d,%p,%p,%d) failed in ebsp_write.\n",
                 prow, pcol, (void*)dst, (void*)src, size);
@@ -57,7 +206,7 @@ int ebsp_write(int pid, void* src, off_t dst, int size) {
 int ebsp_read(int pid, off_t src, void* dst, int size) {
     int prow, pcol;
     _get_p_coords(pid, &prow, &pcol);
-    if (e_read(&state.dev, prow, pcol, src, dst, size) != size) {
+    if (e_read(&state->dev, prow, pcol, src, dst, size) != size) {
         fprintf(stderr,
                 "ERROR: e_read(dev,%d,%d,%p,%p,%d) failed in ebsp_read.\n",
                 prow, pcol, (void*)src, (void*)dst, size);
@@ -67,11 +216,18 @@ int ebsp_read(int pid, off_t src, void* dst, int size) {
 }
 
 int _write_core_syncstate(int pid, int syncstate) {
-    return ebsp_write(pid, &syncstate, (off_t)state.combuf.syncstate_ptr, 1);
+    return ebsp_write(pid, &syncstate, (off_t)state->combuf.syncstate_ptr, 1);
+}
+
+// The offset is relative to the combuf of the current workgroup
+static off_t _combuf_offset(off_t offset) {
+    return (uintptr_t)state->host_combuf_addr - (uintptr_t)state->emem.base +
+           offset;
 }
 
 int _write_extmem(void* src, off_t offset, int size) {
-    if (e_write(&state.emem, 0, 0, offset, src, size) != size) {
+    if (e_write(&state->emem, 0, 0, _combuf_offset(offset), src, size) !=
+        size) {
         fprintf(stderr, "ERROR: _write_extmem(src,%p,%d) failed.\n",
                 (void*)offset, size);
         return 0;
@@ -79,3 +235,13 @@ int _write_extmem(void* src, off_t offset, int size) {
     return 1;
 }
 
+int _read_extmem(void* dst, off_t offset, int size) {
+    if (e_read(&state->emem, 0, 0, _combuf_offset(offset), dst, size) !=
+        size) {
+        fprintf(stderr, "ERROR: _read_extmem(dst,%p,%d) failed.\n",
+                (void*)offset, size);
+        return 0;
+    }
+    return 1;
+}
+
@@ -25,33 +25,34 @@ see the files COPYING and COPYING.LESSER. If not, see
 #include <stdio.h>
 #include <string.h>
 
-extern bsp_state_t state;
+extern bsp_state_t* state;
 
 void ebsp_set_tagsize(int* tag_bytes) {
-    int oldsize = state.combuf.tagsize;
-    state.combuf.tagsize = *tag_bytes;
+    int oldsize = state->combuf.tagsize;
+    state->combuf.tagsize = *tag_bytes;
     *tag_bytes = oldsize;
 }
 
-// TODO: Do not use the local copy state.combuf
-// Instead, copy directly to the memory mapped external memory
-
-// Convert pointers pointing to the local copy state.combuf
-// to epiphany address space and back
-
-void* _pointer_to_e(void* ptr) {
-    return (void*)((unsigned int)ptr - (unsigned)&state.combuf + E_COMBUF_ADDR);
-}
-
-void* _pointer_to_arm(void* ptr) {
-    return (void*)((unsigned int)ptr - E_COMBUF_ADDR + (unsigned)&state.combuf);
-}
+// The message queue and payloads are accessed in the memory mapped
+// external memory directly, pointers in the queue are in the epiphany
+// address space
 
 void ebsp_send_down(int pid, const void* tag, const void* payload, int nbytes) {
-    ebsp_message_queue* q = &state.combuf.message_queue[0];
+    // Messages sent after ebsp_spmd are for the next run
+    if (state->initialized == 3)
+        _prepare_rerun();
+    if (state->initialized != 2) {
+        fprintf(stderr, "ERROR: ebsp_send_down called before bsp_begin or"
+                        " while the program runs.\n");
+        return;
+    }
+
+    ebsp_combuf* combuf = state->host_combuf_addr;
+    ebsp_message_queue* q = &combuf->message_queue[0];
     unsigned int index = q->count;
-    unsigned int payload_offset = state.combuf.data_payloads.buffer_size;
-    unsigned int total_nbytes = state.combuf.tagsize + nbytes;
+    unsigned int payload_offset = combuf->data_payloads.buffer_size;
+    // Keep the chunks that the cores take after this 8-byte aligned
+    unsigned int total_nbytes = (state->combuf.tagsize + nbytes + 7) & ~7;
     void* tag_ptr;
     void* payload_ptr;
 
@@ -67,28 +68,32 @@ void ebsp_send_down(int pid, const void* tag, const void* payload, int nbytes) {
     }
 
     q->count++;
-    state.combuf.data_payloads.buffer_size += total_nbytes;
+    combuf->data_payloads.buffer_size += total_nbytes;
 
-    tag_ptr = &state.combuf.data_payloads.buf[payload_offset];
-    payload_offset += state.combuf.tagsize;
-    payload_ptr = &state.combuf.data_payloads.buf[payload_offset];
+    tag_ptr = &combuf->data_payloads.buf[payload_offset];
+    payload_offset += state->combuf.tagsize;
+    payload_ptr = &combuf->data_payloads.buf[payload_offset];
 
     q->message[index].pid = pid;
-    q->message[index].tag = _pointer_to_e(tag_ptr);
-    q->message[index].payload = _pointer_to_e(payload_ptr);
+    q->message[index].tag = _arm_to_e_pointer(tag_ptr);
+    q->message[index].payload = _arm_to_e_pointer(payload_ptr);
     q->message[index].nbytes = nbytes;
-    memcpy(tag_ptr, tag, state.combuf.tagsize);
+    memcpy(tag_ptr, tag, state->combuf.tagsize);
     memcpy(payload_ptr, payload, nbytes);
 }
 
-int ebsp_get_tagsize() { return state.combuf.tagsize; }
+int ebsp_get_tagsize() { return state->combuf.tagsize; }
 
 void ebsp_qsize(int* packets, int* accum_bytes) {
     *packets = 0;
     *accum_bytes = 0;
 
-    ebsp_message_queue* q = &state.combuf.message_queue[0];
-    int mindex = state.message_index;
+    // There are no messages before bsp_begin or after bsp_end
+    if (state->host_combuf_addr == 0)
+        return;
+
+    ebsp_message_queue* q = &state->host_combuf_addr->message_queue[0];
+    int mindex = state->message_index;
     int qsize = q->count;
 
     // Count everything after mindex
@@ -100,13 +105,15 @@ void ebsp_qsize(int* packets, int* accum_bytes) {
 }
 
 ebsp_message_header* _next_queue_message() {
-    ebsp_message_queue* q = &state.combuf.message_queue[0];
-    if (state.message_index < q->count)
-        return &q->message[state.message_index];
+    if (state->host_combuf_addr == 0)
+        return 0;
+    ebsp_message_queue* q = &state->host_combuf_addr->message_queue[0];
+    if (state->message_index < q->count)
+        return &q->message[state->message_index];
     return 0;
 }
 
-void _pop_queue_message() { state.message_index++; }
+void _pop_queue_message() { state->message_index++; }
 
 void ebsp_get_tag(int* status, void* tag) {
     ebsp_message_header* m = _next_queue_message();
@@ -115,7 +122,7 @@ void ebsp_get_tag(int* status, void* tag) {
         return;
     }
     *status = m->nbytes;
-    memcpy(tag, _pointer_to_arm(m->tag), state.combuf.tagsize);
+    memcpy(tag, _e_to_arm_pointer(m->tag), state->combuf.tagsize);
 }
 
 void ebsp_move(void* payload, int buffer_size) {
@@ -132,7 +139,7 @@ void ebsp_move(void* payload, int buffer_size) {
     if (m->nbytes < buffer_size)
         buffer_size = m->nbytes;
 
-    memcpy(payload, _pointer_to_arm(m->payload), buffer_size);
+    memcpy(payload, _e_to_arm_pointer(m->payload), buffer_size);
 }
 
 int ebsp_hpmove(void** tag_ptr_buf, void** payload_ptr_buf) {
@@ -140,8 +147,7 @@ int ebsp_hpmove(void** tag_ptr_buf, void** payload_ptr_buf) {
     _pop_queue_message();
     if (m == 0)
         return -1;
-    *tag_ptr_buf = _pointer_to_arm(m->tag);
-    *payload_ptr_buf = _pointer_to_arm(m->payload);
+    *tag_ptr_buf = _e_to_arm_pointer(m->tag);
+    *payload_ptr_buf = _e_to_arm_pointer(m->payload);
     return m->nbytes;
 }
-
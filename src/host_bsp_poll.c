@@ -0,0 +1,136 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Needed for pthread_setaffinity_np
+#define _GNU_SOURCE
+#include "host_bsp_private.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+// Polling state of the current ebsp_spmd call
+static int idle_polls;
+static int backoff_sleep;
+
+// Affinity and scheduling of the polling thread before ebsp_spmd
+static int restore_affinity;
+static cpu_set_t saved_cpuset;
+static int restore_sched;
+static int saved_policy;
+static struct sched_param saved_param;
+
+void _poll_set_default() {
+    state->poll_policy.mode = EBSP_POLL_INTERVAL;
+    state->poll_policy.interval = 1;
+    state->poll_policy.spin_count = 0;
+    state->poll_policy.cpu = -1;
+    state->poll_policy.rt_priority = 0;
+}
+
+int ebsp_set_poll_policy(const ebsp_poll_policy* policy) {
+    if (policy->mode != EBSP_POLL_INTERVAL && policy->mode != EBSP_POLL_SPIN &&
+        policy->mode != EBSP_POLL_BACKOFF) {
+        fprintf(stderr, "ERROR: unknown poll mode %d.\n", policy->mode);
+        return 0;
+    }
+    if (policy->interval < 1 && policy->mode != EBSP_POLL_SPIN) {
+        fprintf(stderr, "ERROR: poll interval must be at least 1 microsecond.\n");
+        return 0;
+    }
+    state->poll_policy = *policy;
+    return 1;
+}
+
+void _poll_begin() {
+    idle_polls = 0;
+    backoff_sleep = 1;
+    restore_affinity = 0;
+    restore_sched = 0;
+
+    pthread_t self = pthread_self();
+
+    if (state->poll_policy.cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(state->poll_policy.cpu, &cpuset);
+        if (pthread_getaffinity_np(self, sizeof(cpu_set_t), &saved_cpuset) ==
+                0 &&
+            pthread_setaffinity_np(self, sizeof(cpu_set_t), &cpuset) == 0)
+            restore_affinity = 1;
+        else
+            fprintf(stderr, "WARNING: could not run poll thread on CPU %d.\n",
+                    state->poll_policy.cpu);
+    }
+
+    if (state->poll_policy.rt_priority != 0) {
+        struct sched_param param;
+        param.sched_priority = state->poll_policy.rt_priority;
+        if (pthread_getschedparam(self, &saved_policy, &saved_param) == 0 &&
+            pthread_setschedparam(self, SCHED_FIFO, &param) == 0)
+            restore_sched = 1;
+        else
+            fprintf(stderr,
+                    "WARNING: could not set real-time priority %d for poll "
+                    "thread.\n",
+                    state->poll_policy.rt_priority);
+    }
+}
+
+// Called once per iteration of the ebsp_spmd loop.
+// `busy` is nonzero when the previous poll found something to do
+void _poll_wait(int busy) {
+    switch (state->poll_policy.mode) {
+    case EBSP_POLL_SPIN:
+        break;
+
+    case EBSP_POLL_INTERVAL:
+        _microsleep(state->poll_policy.interval);
+        break;
+
+    case EBSP_POLL_BACKOFF:
+        if (busy) {
+            idle_polls = 0;
+            backoff_sleep = 1;
+            break;
+        }
+        if (idle_polls < state->poll_policy.spin_count) {
+            ++idle_polls;
+            break;
+        }
+        _microsleep(backoff_sleep);
+        backoff_sleep *= 2;
+        if (backoff_sleep > state->poll_policy.interval)
+            backoff_sleep = state->poll_policy.interval;
+        break;
+    }
+}
+
+void _poll_end() {
+    pthread_t self = pthread_self();
+    if (restore_affinity)
+        pthread_setaffinity_np(self, sizeof(cpu_set_t), &saved_cpuset);
+    if (restore_sched)
+        pthread_setschedparam(self, saved_policy, &saved_param);
+    restore_affinity = 0;
+    restore_sched = 0;
+}
@@ -0,0 +1,231 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "host_bsp_private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* event_names[] = {"sync", "callback", "release", "finish"};
+
+int ebsp_timeline_enable(int capacity) {
+    if (state->initialized == 0) {
+        fprintf(stderr, "ERROR: ebsp_timeline_enable called before bsp_init.\n");
+        return 0;
+    }
+    if (capacity < 0) {
+        fprintf(stderr, "ERROR: invalid timeline capacity %d.\n", capacity);
+        return 0;
+    }
+
+    free(state->timeline);
+    state->timeline = 0;
+    state->timeline_capacity = 0;
+    state->timeline_count = 0;
+
+    if (capacity == 0)
+        return 1;
+
+    state->timeline = malloc(capacity * sizeof(ebsp_timeline_record));
+    if (state->timeline == 0) {
+        fprintf(stderr, "ERROR: could not allocate %d timeline records.\n",
+                capacity);
+        return 0;
+    }
+    state->timeline_capacity = capacity;
+    return 1;
+}
+
+void _timeline_begin() {
+    state->timeline_count = 0;
+    for (int i = 0; i < NPROCS; i++)
+        state->timeline_syncstate[i] = STATE_INIT;
+}
+
+void _timeline_record(ebsp_timeline_event event, int superstep, int pid) {
+    if (state->timeline == 0)
+        return;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    ebsp_timeline_record* rec =
+        &state->timeline[state->timeline_count % state->timeline_capacity];
+    rec->event = event;
+    rec->superstep = superstep;
+    rec->pid = pid;
+    rec->time = (ts.tv_sec - state->ts_start.tv_sec) +
+                (ts.tv_nsec - state->ts_start.tv_nsec) * 1e-9;
+    state->timeline_count++;
+
+    // A core can sync again before the next poll, so every sync after a
+    // release is a transition
+    if (event == EBSP_TIMELINE_RELEASE)
+        for (int i = 0; i < NPROCS; i++)
+            state->timeline_syncstate[i] = STATE_CONTINUE;
+}
+
+void _timeline_update(int superstep) {
+    if (state->timeline == 0)
+        return;
+
+    for (int i = 0; i < state->nprocs_used; i++) {
+        int8_t s = state->combuf.syncstate[i];
+        int8_t prev = state->timeline_syncstate[i];
+        if (s == prev)
+            continue;
+        state->timeline_syncstate[i] = s;
+        if (s == STATE_SYNC)
+            _timeline_record(EBSP_TIMELINE_SYNC, superstep, i);
+        else if (s == STATE_FINISH ||
+                 (s == STATE_PARKED && prev != STATE_FINISH))
+            _timeline_record(EBSP_TIMELINE_FINISH, superstep, i);
+    }
+}
+
+int ebsp_timeline_records(ebsp_timeline_record* records, int max_records) {
+    if (state->timeline == 0)
+        return 0;
+
+    int count = state->timeline_count;
+    int first = 0;
+    if (count > state->timeline_capacity) {
+        first = count - state->timeline_capacity;
+        count = state->timeline_capacity;
+    }
+    if (count > max_records)
+        count = max_records;
+
+    for (int i = 0; i < count; i++)
+        records[i] = state->timeline[(first + i) % state->timeline_capacity];
+    return count;
+}
+
+// Write a complete ("X") event of the Chrome trace format
+static void _write_span(FILE* f, int* first, const char* name, int pid,
+                        int superstep, double begin, double end) {
+    fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+               "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"superstep\":%d}}",
+            *first ? "" : ",", name, pid + 1, begin * 1e6,
+            (end - begin) * 1e6, superstep);
+    *first = 0;
+}
+
+static void _write_chrome(FILE* f, const ebsp_timeline_record* records,
+                          int count) {
+    // Start of the current span of every core, and of the host callback
+    double compute_start[NPROCS];
+    double wait_start[NPROCS];
+    double callback_start = -1.0;
+    int first = 1;
+
+    for (int i = 0; i < NPROCS; i++) {
+        compute_start[i] = 0.0;
+        wait_start[i] = -1.0;
+    }
+
+    fprintf(f, "{\"traceEvents\":[");
+
+    fprintf(f, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+               "\"args\":{\"name\":\"host\"}}");
+    for (int i = 0; i < state->nprocs_used; i++)
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                   "\"tid\":%d,\"args\":{\"name\":\"core %d\"}}",
+                i + 1, i);
+    first = 0;
+
+    for (int r = 0; r < count; r++) {
+        const ebsp_timeline_record* rec = &records[r];
+        switch (rec->event) {
+        case EBSP_TIMELINE_SYNC:
+        case EBSP_TIMELINE_FINISH:
+            if (compute_start[rec->pid] >= 0.0)
+                _write_span(f, &first, "computing", rec->pid, rec->superstep,
+                            compute_start[rec->pid], rec->time);
+            compute_start[rec->pid] = -1.0;
+            if (rec->event == EBSP_TIMELINE_SYNC)
+                wait_start[rec->pid] = rec->time;
+            break;
+
+        case EBSP_TIMELINE_CALLBACK:
+            callback_start = rec->time;
+            break;
+
+        case EBSP_TIMELINE_RELEASE:
+            if (callback_start >= 0.0)
+                _write_span(f, &first, "callback", -1, rec->superstep,
+                            callback_start, rec->time);
+            callback_start = -1.0;
+            for (int i = 0; i < state->nprocs_used; i++) {
+                if (wait_start[i] >= 0.0)
+                    _write_span(f, &first, "waiting", i, rec->superstep,
+                                wait_start[i], rec->time);
+                wait_start[i] = -1.0;
+                compute_start[i] = rec->time;
+            }
+            break;
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+}
+
+int ebsp_timeline_dump(const char* filename, ebsp_timeline_format format) {
+    if (state->timeline == 0) {
+        fprintf(stderr, "ERROR: ebsp_timeline_dump called while the timeline"
+                        " is not enabled.\n");
+        return 0;
+    }
+    if (format != EBSP_TIMELINE_CSV && format != EBSP_TIMELINE_CHROME) {
+        fprintf(stderr, "ERROR: unknown timeline format %d.\n", format);
+        return 0;
+    }
+
+    ebsp_timeline_record* records =
+        malloc(state->timeline_capacity * sizeof(ebsp_timeline_record));
+    if (records == 0) {
+        fprintf(stderr, "ERROR: could not allocate timeline records.\n");
+        return 0;
+    }
+    int count = ebsp_timeline_records(records, state->timeline_capacity);
+
+    FILE* f = fopen(filename, "w");
+    if (f == 0) {
+        fprintf(stderr, "ERROR: could not open %s.\n", filename);
+        free(records);
+        return 0;
+    }
+
+    if (format == EBSP_TIMELINE_CSV) {
+        fprintf(f, "superstep,pid,event,time_us\n");
+        for (int r = 0; r < count; r++)
+            fprintf(f, "%d,%d,%s,%.3f\n", records[r].superstep, records[r].pid,
+                    event_names[records[r].event], records[r].time * 1e6);
+    } else {
+        _write_chrome(f, records, count);
+    }
+
+    fclose(f);
+    free(records);
+    return 1;
+}
@@ -28,30 +28,36 @@ see the files COPYING and COPYING.LESSER. If not, see
 
 #include <unistd.h> // readlink, for getting the path to the executable
 
-void ebsp_set_sync_callback(void (*cb)()) { state.sync_callback = cb; }
+void ebsp_set_sync_callback(void (*cb)()) { state->sync_callback = cb; }
 
-void ebsp_set_end_callback(void (*cb)()) { state.end_callback = cb; }
+void ebsp_set_end_callback(void (*cb)()) { state->end_callback = cb; }
 
 // Converting between epiphany and arm pointers
 // Used for pointers returned from ebsp_ext_malloc
 
+// The mapping starts at E_COMBUF_ADDR for every workgroup
+
 void* _arm_to_e_pointer(void* ptr) {
-    return (void*)((unsigned)ptr - (unsigned)state.host_combuf_addr +
+    return (void*)((uintptr_t)ptr - (uintptr_t)state->emem.base +
                    E_COMBUF_ADDR);
 }
 
 void* _e_to_arm_pointer(void* ptr) {
-    return (void*)((unsigned)ptr - E_COMBUF_ADDR +
-                   (unsigned)state.host_combuf_addr);
+    return (void*)((uintptr_t)ptr - E_COMBUF_ADDR +
+                   (uintptr_t)state->emem.base);
 }
 
 void _update_remote_timer() {
     // Current time. Repeat these lines every iteration
-    clock_gettime(CLOCK_MONOTONIC, &state.ts_end);
+    clock_gettime(CLOCK_MONOTONIC, &state->ts_end);
 
     float time_elapsed =
-        (state.ts_end.tv_sec - state.ts_start.tv_sec +
-         (state.ts_end.tv_nsec - state.ts_start.tv_nsec) * 1.0e-9);
+        (state->ts_end.tv_sec - state->ts_start.tv_sec +
+         (state->ts_end.tv_nsec - state->ts_start.tv_nsec) * 1.0e-9);
+
+    if (time_elapsed < state->remote_time + REMOTE_TIMER_RESOLUTION)
+        return;
+    state->remote_time = time_elapsed;
 
     _write_extmem(&time_elapsed, offsetof(ebsp_combuf, remotetimer),
                   sizeof(float));
@@ -70,15 +76,15 @@ void _microsleep(int microseconds) {
 }
 
 void _get_p_coords(int pid, int* row, int* col) {
-    (*row) = pid / state.cols;
-    (*col) = pid % state.cols;
+    (*row) = pid / state->cols;
+    (*col) = pid % state->cols;
 }
 
 // Get the directory that the application is running in
-// and store it in state.e_directory
+// and store it in state->e_directory
 // It will include a trailing slash
 void init_application_path() {
-    state.e_directory[0] = 0;
+    state->e_directory[0] = 0;
     char path[1024];
     ssize_t len = readlink("/proc/self/exe", path, 1024);
     if (len > 0 && len < 1024) {
@@ -86,13 +92,13 @@ void init_application_path() {
         char* slash = strrchr(path, '/');
         if (slash) {
             int count = slash - path + 1;
-            memcpy(state.e_directory, path, count);
-            state.e_directory[count + 1] = 0;
+            memcpy(state->e_directory, path, count);
+            state->e_directory[count + 1] = 0;
         }
     }
-    if (state.e_directory[0] == 0) {
+    if (state->e_directory[0] == 0) {
         fprintf(stderr, "ERROR: Could not find process directory.\n");
-        memcpy(state.e_directory, "./", 3); // including terminating 0
+        memcpy(state->e_directory, "./", 3); // including terminating 0
     }
     return;
 }
@@ -0,0 +1,86 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+#define TASKS 200
+
+int counter = 0;
+int done[TASKS];
+int owner = 0;
+int winners = 0;
+int slot = 0;
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+    int p = bsp_nprocs();
+
+    slot = 1000 + s;
+    bsp_push_reg(&counter, sizeof(int));
+    bsp_sync();
+    bsp_push_reg(&done, sizeof(done));
+    bsp_sync();
+    bsp_push_reg(&owner, sizeof(int));
+    bsp_sync();
+    bsp_push_reg(&winners, sizeof(int));
+    bsp_sync();
+    bsp_push_reg(&slot, sizeof(int));
+    bsp_sync();
+
+    // All cores take tasks from the counter on core 0 until there are none
+    // left, and mark them as done on core 0
+    int task;
+    while ((task = ebsp_atomic_fetch_add(0, &counter, 0, 1)) < TASKS)
+        ebsp_atomic_fetch_add(0, &done, task * sizeof(int), 1);
+
+    // Only one core can change the owner from 0
+    int won = (ebsp_atomic_cas(0, &owner, 0, 0, s + 1) == 0);
+    ebsp_atomic_fetch_add(0, &winners, 0, won);
+
+    int old = ebsp_atomic_swap((s + 1) % p, &slot, 0, s);
+    ebsp_barrier();
+
+    // test: every task was taken exactly once, and every core took one
+    // more number from the counter to find that there were none left
+    if (s == 0) {
+        int once = 1;
+        for (int i = 0; i < TASKS; ++i)
+            once = once && (done[i] == 1);
+        ebsp_message("%i %i", counter, once);
+    }
+    // expect: ($00: 216 1)
+
+    // test: a single core changed the owner
+    if (s == 0)
+        ebsp_message("%i %i", winners, owner != 0);
+    // expect: ($00: 1 1)
+
+    // test: swap returns the old value
+    EBSP_MSG_ORDERED("%i %i", old, slot);
+    // expect_for_pid: ("%i %i" % (1000 + (pid + 1) % 16, (pid - 1) % 16))
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+    int n = bsp_nprocs();
+
+    // The host sends the workgroup id to every core
+    int group = -1;
+    int packets = 0;
+    int accum_bytes = 0;
+    bsp_qsize(&packets, &accum_bytes);
+    if (packets == 1) {
+        int status = 0;
+        int tag = 0;
+        bsp_get_tag(&status, &tag);
+        bsp_move(&group, sizeof(int));
+    }
+
+    // Every workgroup has its own barrier and registered variables
+    int values[16];
+    bsp_push_reg(values, sizeof(values));
+    bsp_sync();
+    for (int s = 0; s < n; s++)
+        bsp_hpput(s, &group, values, p * sizeof(int), sizeof(int));
+    bsp_sync();
+
+    int sum = 0;
+    for (int s = 0; s < n; s++)
+        sum += values[s];
+
+    // And its own external memory
+    int* buffer = ebsp_ext_malloc(sizeof(int));
+    if (buffer) {
+        *buffer = sum;
+        sum = *buffer;
+        ebsp_free(buffer);
+    } else {
+        sum = -1;
+    }
+
+    int result = 100 * n + sum;
+    ebsp_send_up(&p, &result, sizeof(int));
+
+    bsp_end();
+
+    return 0;
+}
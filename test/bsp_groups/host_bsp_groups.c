@@ -0,0 +1,92 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+#define GROUPS 4
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_groups.elf", argc, argv);
+
+    // Four programs of 2x2 cores run at the same time
+    int tagsize = sizeof(int);
+    for (int g = 0; g < GROUPS; g++) {
+        if (ebsp_group_begin("e_bsp_groups.elf", 2 * (g / 2), 2 * (g % 2), 2,
+                             2) != g) {
+            printf("ebsp_group_begin failed\n");
+            return 1;
+        }
+        ebsp_set_tagsize(&tagsize);
+        for (int pid = 0; pid < bsp_nprocs(); pid++)
+            ebsp_send_down(pid, &pid, &g, sizeof(int));
+    }
+    printf("nprocs: %d\n", bsp_nprocs());
+
+    printf("overlap: %d\n", ebsp_group_begin("e_bsp_groups.elf", 1, 1, 2, 2));
+
+    for (int g = 0; g < GROUPS; g++) {
+        ebsp_group_select(g);
+        ebsp_spmd_start();
+    }
+
+    int running = GROUPS;
+    while (running) {
+        running = 0;
+        for (int g = 0; g < GROUPS; g++) {
+            ebsp_group_select(g);
+            running += ebsp_spmd_poll();
+        }
+    }
+
+    // Every core of workgroup g sends 100 * 4 + 4 * g
+    for (int g = 0; g < GROUPS; g++) {
+        ebsp_group_select(g);
+        int result = ebsp_spmd_wait();
+
+        int packets, accum_bytes;
+        ebsp_qsize(&packets, &accum_bytes);
+        int correct = 0;
+        for (int i = 0; i < packets; i++) {
+            int tag, status, payload;
+            ebsp_get_tag(&status, &tag);
+            ebsp_move(&payload, sizeof(int));
+            if (payload == 400 + 4 * g)
+                correct++;
+        }
+        printf("group %d: %d %d\n", g, result, correct);
+    }
+
+    bsp_end();
+
+    printf("Done\n");
+
+    // expect: (ERROR: ebsp_group_begin called with core (1,1), which is in workgroup 0.)
+    // expect: (nprocs: 4)
+    // expect: (overlap: -1)
+    // expect: (group 0: 1 4)
+    // expect: (group 1: 1 4)
+    // expect: (group 2: 1 4)
+    // expect: (group 3: 1 4)
+    // expect: (Done)
+    return 0;
+}
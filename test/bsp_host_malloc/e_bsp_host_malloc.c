@@ -0,0 +1,41 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int main() {
+    do {
+        bsp_begin();
+
+        // The cores use the shared heap while the host allocates
+        for (int i = 0; i < 3; i++) {
+            void* buffer = ebsp_ext_malloc(100);
+            if (buffer)
+                ebsp_free(buffer);
+            ebsp_host_sync();
+        }
+
+        bsp_end();
+    } while (ebsp_next_run());
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+#include <string.h>
+
+int syncs = 0;
+void* sync_buffers[3];
+
+// All cores wait, so this memory comes from the shared heap
+void sync_callback() {
+    if (syncs < 3)
+        sync_buffers[syncs] = ebsp_ext_malloc(256);
+    syncs++;
+}
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_host_malloc.elf", argc, argv);
+    bsp_begin(bsp_nprocs());
+    ebsp_set_sync_callback(sync_callback);
+
+    // Without a host heap the host can not allocate during the run
+    void* early = ebsp_ext_malloc(64);
+    ebsp_spmd_start();
+    printf("no host heap: %d\n", ebsp_ext_malloc(64) == 0);
+    // The errors go to stderr, which comes before the buffered stdout
+    // expect: (ERROR: ebsp_ext_malloc called while the Epiphany program is running, without a host heap.)
+    // expect: (ERROR: ebsp_set_host_heap_size called after the host heap was reserved.)
+    // expect: (no host heap: 1)
+    ebsp_spmd_wait();
+
+    syncs = 0;
+    ebsp_set_host_heap_size(0x10000);
+    ebsp_spmd_start();
+    printf("set again: %d\n", ebsp_set_host_heap_size(0x20000));
+    // expect: (set again: 0)
+
+    // Between polls the memory comes from the host heap, and is reused
+    // after it is freed. Shared memory that is freed is released later
+    ebsp_free(early);
+    void* first = 0;
+    int host_heap_ok = 1;
+    while (ebsp_spmd_poll()) {
+        char* buffer = ebsp_ext_malloc(1024);
+        if (buffer == 0 || (first != 0 && buffer != first))
+            host_heap_ok = 0;
+        if (buffer) {
+            memset(buffer, 1, 1024);
+            ebsp_free(buffer);
+        }
+        first = buffer;
+    }
+    printf("host heap: %d\n", host_heap_ok);
+    // expect: (host heap: 1)
+
+    int sync_ok = (syncs == 3);
+    for (int i = 0; i < 3 && sync_ok; i++)
+        if (sync_buffers[i] == 0 || sync_buffers[i] == first)
+            sync_ok = 0;
+    printf("sync callback: %d\n", sync_ok);
+    // expect: (sync callback: 1)
+
+    printf("deferred free: %d\n", ebsp_ext_malloc(64) == early);
+    // expect: (deferred free: 1)
+
+    bsp_end();
+
+    return 0;
+}
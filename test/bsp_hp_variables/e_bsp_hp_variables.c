@@ -82,6 +82,36 @@ int main() {
     EBSP_MSG_ORDERED("%i", data);
     // expect_for_pid: ("4")
 
+    // test: the other core writes the data of ebsp_hpget_push, more than
+    // fit in its inbox
+    int pushed[6] = {0};
+    for (int i = 0; i < 6; ++i)
+        ebsp_hpget_push((s + 1) % p, &c, i * sizeof(int), &pushed[i],
+                        sizeof(int));
+    ebsp_barrier();
+    ebsp_barrier();
+
+    EBSP_MSG_ORDERED("%i", pushed[0] + pushed[5]);
+    // expect_for_pid: ("5")
+
+    // test: an ebsp_hpget_push after a bsp_get to the same core is not
+    // held up by it
+    int got = 0;
+    int pushed_after = 0;
+    bsp_get((s + 1) % p, &c, 7 * sizeof(int), &got, sizeof(int));
+    ebsp_hpget_push((s + 1) % p, &c, 9 * sizeof(int), &pushed_after,
+                    sizeof(int));
+    ebsp_barrier();
+    ebsp_barrier();
+
+    EBSP_MSG_ORDERED("%i", pushed_after);
+    // expect_for_pid: ("9")
+
+    bsp_sync();
+
+    EBSP_MSG_ORDERED("%i", got);
+    // expect_for_pid: ("7")
+
     bsp_end();
 
     return 0;
@@ -25,6 +25,7 @@ see the files COPYING and COPYING.LESSER. If not, see
 int main(int argc, char** argv) {
     bsp_init("e_bsp_hp_variables.elf", argc, argv);
     bsp_begin(bsp_nprocs());
+    ebsp_set_get_inbox_size(4);
     ebsp_spmd();
     bsp_end();
 
@@ -43,6 +43,9 @@ int main() {
     // register multiple variables within one sync
     // noexpect: ($02: BSP ERROR: multiple bsp_push_reg calls within one sync)
 
+    // Core 1 has to register teststr before core 0 can write to it
+    ebsp_barrier();
+
     if (bsp_pid() == 1) {
         bsp_hpput(0, &var, &var, 0, sizeof(int));
         bsp_hpput(0, &var, unregistered_var, 0, sizeof(int)); // Error
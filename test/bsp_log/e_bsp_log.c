@@ -0,0 +1,83 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int runs = 0;
+
+int main() {
+    do {
+        bsp_begin();
+        runs++;
+
+        int p = bsp_pid();
+        int n = bsp_nprocs();
+
+        if (runs == 1) {
+            // The messages of a superstep are sorted by pid
+            // expect_for_pid: (pid)
+            ebsp_message("%d", p);
+            bsp_sync();
+
+            // expect: ($00: first)
+            // expect: ($00: second)
+            // expect: ($15: third)
+            if (p == n - 1)
+                ebsp_message("third");
+            if (p == 0) {
+                ebsp_message("first");
+                ebsp_message("second");
+            }
+
+            // Messages are printed before the sync callback
+            // expect: (callback)
+            ebsp_host_sync();
+        } else {
+            // The host does not poll, so only 16 of these fit in the ring
+            if (p == 0)
+                for (int i = 0; i < 18; i++)
+                    ebsp_message("%03d %s", i, "....................................................................................................................");
+            // expect: ($00: 000 ....................................................................................................................)
+            // expect: ($00: 001 ....................................................................................................................)
+            // expect: ($00: 002 ....................................................................................................................)
+            // expect: ($00: 003 ....................................................................................................................)
+            // expect: ($00: 004 ....................................................................................................................)
+            // expect: ($00: 005 ....................................................................................................................)
+            // expect: ($00: 006 ....................................................................................................................)
+            // expect: ($00: 007 ....................................................................................................................)
+            // expect: ($00: 008 ....................................................................................................................)
+            // expect: ($00: 009 ....................................................................................................................)
+            // expect: ($00: 010 ....................................................................................................................)
+            // expect: ($00: 011 ....................................................................................................................)
+            // expect: ($00: 012 ....................................................................................................................)
+            // expect: ($00: 013 ....................................................................................................................)
+            // expect: ($00: 014 ....................................................................................................................)
+            // expect: ($00: 015 ....................................................................................................................)
+            // expect: (WARNING: 2 messages of core 0 were dropped.)
+        }
+
+        bsp_end();
+    } while (ebsp_next_run());
+
+    return 0;
+}
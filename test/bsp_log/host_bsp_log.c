@@ -0,0 +1,50 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <host_bsp.h>
+#include <stdio.h>
+#include <time.h>
+
+void sync_callback() { printf("callback\n"); }
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_log.elf", argc, argv);
+    bsp_begin(bsp_nprocs());
+    ebsp_set_sync_callback(sync_callback);
+
+    ebsp_spmd();
+
+    // The cores write to their log ring while the host does not poll
+    ebsp_set_log_policy(EBSP_LOG_DROP);
+    ebsp_spmd_start();
+    struct timespec delay = {0, 200000000};
+    nanosleep(&delay, 0);
+    ebsp_spmd_wait();
+
+    bsp_end();
+
+    printf("Done\n");
+
+    // expect: (Done)
+    return 0;
+}
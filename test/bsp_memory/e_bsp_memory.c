@@ -28,70 +28,127 @@ see the files COPYING and COPYING.LESSER. If not, see
 int bufferTestSizes[RUNCOUNT] = {1, 2, 3, 4, 5, 6, 7, 8, 0x100,
     0x1000, 0x2000, 0x9000};
 
+int runs = 0;
+
 int main()
 {
-    bsp_begin();
-    int s = bsp_pid();
-
-    int globalPass = 1;
-    for (int run = 0; run < RUNCOUNT; ++run) {
-        int BUFFERSIZE = bufferTestSizes[run];
-
-        // Allocate buffers
-        char* localbuffer = ebsp_malloc(BUFFERSIZE);
-        char* remotebuffer = ebsp_ext_malloc(BUFFERSIZE); // slow
-
-        // Write to start and end of buffer to confirm
-        // locatations are writable
-
-        if (localbuffer) {
-            localbuffer[0] = 1;
-            localbuffer[BUFFERSIZE - 1] = 2;
-        }
-        if (remotebuffer) {
-            remotebuffer[0] = 3;
-            remotebuffer[BUFFERSIZE - 1] = 4;
+    do {
+        bsp_begin();
+        runs++;
+        int s = bsp_pid();
+
+        int globalPass = 1;
+
+        // Scratch allocations are next to each other, and a release
+        // frees everything after the mark, including a second block
+        void* outer = ebsp_scratch_mark();
+        char* a = ebsp_scratch_alloc(100);
+        char* b = ebsp_scratch_alloc(100);
+        void* inner = ebsp_scratch_mark();
+        char* large = ebsp_scratch_alloc(0x1000);
+        ebsp_scratch_release(inner);
+        char* c = ebsp_scratch_alloc(100);
+        ebsp_scratch_release(outer);
+        char* d = ebsp_scratch_alloc(100);
+        ebsp_scratch_release(outer);
+        if (b != a + 104 || large == 0 || c != b + 104 || d != a) {
+            globalPass = 0;
+            ebsp_message("ERROR: scratch allocations at %p, %p, %p, %p", a,
+                         b, c, d);
         }
 
-        ebsp_barrier();
-
-        // Read from buffers to confirm they are readable
-        char total = 0;
-        if (localbuffer) {
-            total += localbuffer[0];
-            total += localbuffer[BUFFERSIZE - 1];
+        // The banks are not used yet, so the buffers are at the start of
+        // the banks. An invalid bank gives memory from any bank
+        char* bank2 = ebsp_malloc_bank(100, 2);
+        char* bank3 = ebsp_malloc_bank(100, 3);
+        char* anybank = ebsp_malloc_bank(100, 7);
+        if (bank3 != bank2 + 0x2000 || anybank == 0) {
+            globalPass = 0;
+            ebsp_message("ERROR: bank allocations at %p, %p and %p", bank2,
+                         bank3, anybank);
         }
-        if (remotebuffer) {
-            total += remotebuffer[0];
-            total += remotebuffer[BUFFERSIZE - 1];
+        ebsp_free(bank2);
+        ebsp_free(bank3);
+        if (anybank)
+            ebsp_free(anybank);
+
+        if (runs == 2) {
+            // The host has set an arena size. Allocations from the arena
+            // are next to each other, after a header of 8 bytes, and it is
+            // reused after they are freed
+            char* a = ebsp_ext_malloc(100);
+            char* b = ebsp_ext_malloc(100);
+            ebsp_free(a);
+            ebsp_free(b);
+            char* c = ebsp_ext_malloc(100);
+            ebsp_free(c);
+            if (b != a + 112 || c != a) {
+                globalPass = 0;
+                ebsp_message("ERROR: arena allocations at %p, %p and %p", a,
+                             b, c);
+            }
         }
 
-        char expectedtotal = 0;
-        if (BUFFERSIZE == 1) {
-            expectedtotal = 12; // because buffer[0] = buffer[N - 1]
-        } else {
-            if (localbuffer)
-                expectedtotal += 3;
-            if (remotebuffer)
-                expectedtotal += 7;
+        for (int run = 0; run < RUNCOUNT; ++run) {
+            int BUFFERSIZE = bufferTestSizes[run];
+
+            // Allocate buffers
+            char* localbuffer = ebsp_malloc(BUFFERSIZE);
+            char* remotebuffer = ebsp_ext_malloc(BUFFERSIZE); // slow
+
+            // Write to start and end of buffer to confirm
+            // locatations are writable
+
+            if (localbuffer) {
+                localbuffer[0] = 1;
+                localbuffer[BUFFERSIZE - 1] = 2;
+            }
+            if (remotebuffer) {
+                remotebuffer[0] = 3;
+                remotebuffer[BUFFERSIZE - 1] = 4;
+            }
+
+            ebsp_barrier();
+
+            // Read from buffers to confirm they are readable
+            char total = 0;
+            if (localbuffer) {
+                total += localbuffer[0];
+                total += localbuffer[BUFFERSIZE - 1];
+            }
+            if (remotebuffer) {
+                total += remotebuffer[0];
+                total += remotebuffer[BUFFERSIZE - 1];
+            }
+
+            char expectedtotal = 0;
+            if (BUFFERSIZE == 1) {
+                expectedtotal = 12; // because buffer[0] = buffer[N - 1]
+            } else {
+                if (localbuffer)
+                    expectedtotal += 3;
+                if (remotebuffer)
+                    expectedtotal += 7;
+            }
+
+            if (total != expectedtotal) {
+                globalPass = 0;
+                ebsp_message("ERROR: At BUFFERSIZE = %d = 0x%x, 'total' is %d",
+                        BUFFERSIZE, BUFFERSIZE, total);
+            }
+
+            // Free buffers
+            if (localbuffer) ebsp_free(localbuffer);
+            if (remotebuffer) ebsp_free(remotebuffer);
         }
-
-        if (total != expectedtotal) {
-            globalPass = 0;
-            ebsp_message("ERROR: At BUFFERSIZE = %d = 0x%x, 'total' is %d",
-                    BUFFERSIZE, BUFFERSIZE, total);
-        }
-
-        // Free buffers
-        if (localbuffer) ebsp_free(localbuffer);
-        if (remotebuffer) ebsp_free(remotebuffer);
-    }
-    
-    if (s == 0)
-        ebsp_message(globalPass ? "PASS" : "FAIL");
-    // expect: ($00: PASS)
-
-    bsp_end();
+        
+        if (s == 0)
+            ebsp_message(globalPass ? "PASS" : "FAIL");
+        // expect: ($00: PASS)
+        // expect: ($00: PASS)
+
+        bsp_end();
+    } while (ebsp_next_run());
 
     return 0;
 }
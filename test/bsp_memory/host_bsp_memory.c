@@ -21,12 +21,36 @@ see the files COPYING and COPYING.LESSER. If not, see
 */
 
 #include <host_bsp.h>
+#include <stdio.h>
 
 int main(int argc, char **argv)
 {
     bsp_init("e_bsp_memory.elf", argc, argv);
     bsp_begin(bsp_nprocs());
     ebsp_spmd();
+
+    // The second run uses arenas, and the largest buffers do not fit
+    ebsp_set_ext_arena_size(0x4000);
+    ebsp_spmd();
+
+    // The buffer of 0x9000 bytes does not fit in local memory, and every
+    // buffer of the external memory is freed
+    ebsp_malloc_stats local, ext;
+    ebsp_get_malloc_stats(0, &local);
+    ebsp_get_ext_malloc_stats(&ext);
+    printf("local heap: %s\n",
+           (local.failed >= 1 && local.peak_bytes >= local.live_bytes &&
+            local.allocs >= local.frees && local.largest_free_run > 0)
+               ? "PASS"
+               : "FAIL");
+    // expect: (local heap: PASS)
+    printf("external heap: %s\n",
+           (ext.failed == 0 && ext.peak_bytes >= 0x9000 &&
+            ext.allocs >= ext.frees && ext.largest_free_run > 0)
+               ? "PASS"
+               : "FAIL");
+    // expect: (external heap: PASS)
+
     bsp_end();
 
     return 0;
@@ -0,0 +1,67 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include <string.h>
+#include "../common.h"
+
+int main() {
+    bsp_begin();
+
+    int p = bsp_pid();
+
+    // expect_for_pid: (pid)
+    ebsp_message_deferred("%d", p);
+    bsp_sync();
+
+    if (p == 0) {
+        // expect: ($00: int -7 unsigned 4000000000 hex 0x2a)
+        ebsp_message_deferred("int %d unsigned %u hex %#x", -7, 4000000000u,
+                              42);
+        // expect: ($00: long 1234567890123 5 16)
+        ebsp_message_deferred("long %lld %ld %zu", 1234567890123ll, 5l,
+                              sizeof(int) * 4);
+        // expect: ($00: double 3.25 1.5e+10)
+        ebsp_message_deferred("double %.2f %g", 3.25, 1.5e10);
+        // expect: ($00: char [  abc] [x] 100%)
+        ebsp_message_deferred("char [%5s] [%c] 100%%", "abc", 'x');
+        // expect: ($00: width [   12] [ab])
+        ebsp_message_deferred("width [%*d] [%.*s]", 5, 12, 2, "abcd");
+
+        // Strings are copied when the message is written
+        // expect: ($00: copied before)
+        char word[8];
+        strcpy(word, "before");
+        ebsp_message_deferred("copied %s", word);
+        strcpy(word, "after");
+
+        // Messages of both kinds stay in order
+        // expect: ($00: formatted on the core 1)
+        // expect: ($00: formatted on the host 2)
+        ebsp_message("formatted on the core %d", 1);
+        ebsp_message_deferred("formatted on the host %d", 2);
+    }
+
+    bsp_end();
+
+    return 0;
+}
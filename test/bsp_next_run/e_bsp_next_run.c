@@ -0,0 +1,71 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int runs = 0;
+int* kept = 0;
+
+int main() {
+    do {
+        bsp_begin();
+
+        int packets = 0;
+        int accum_bytes = 0;
+        bsp_qsize(&packets, &accum_bytes);
+
+        int payload = 0;
+        int status = 0;
+        int tag = 0;
+        if (packets == 1) {
+            bsp_get_tag(&status, &tag);
+            bsp_move(&payload, sizeof(int));
+        }
+
+        bsp_sync();
+
+        // Global variables keep their value between runs
+        runs++;
+        payload += bsp_pid() + runs;
+
+        // Memory of the ext arena of the first run is freed in the second,
+        // after which the arena is empty and used again
+        if (runs == 1) {
+            kept = ebsp_ext_malloc(sizeof(int));
+            *kept = 1234;
+        } else if (runs == 2) {
+            int ok = (*kept == 1234);
+            ebsp_free(kept);
+            int* again = ebsp_ext_malloc(sizeof(int));
+            if (!ok || again != kept)
+                payload = -1;
+            ebsp_free(again);
+        }
+        tag = bsp_pid();
+        ebsp_send_up(&tag, &payload, sizeof(int));
+
+        bsp_end();
+    } while (ebsp_next_run());
+
+    return 0;
+}
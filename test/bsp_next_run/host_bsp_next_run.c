@@ -0,0 +1,77 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_next_run.elf", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    int tagsize = sizeof(int);
+    ebsp_set_tagsize(&tagsize);
+    ebsp_set_ext_arena_size(0x400);
+
+    // The program is loaded once and runs several times
+    for (int run = 1; run <= 3; run++) {
+        for (int pid = 0; pid < bsp_nprocs(); pid++) {
+            int payload = 100 * run;
+            ebsp_send_down(pid, &pid, &payload, sizeof(int));
+        }
+
+        if (!ebsp_spmd()) {
+            printf("run %d failed\n", run);
+            break;
+        }
+
+        int packets, accum_bytes;
+        ebsp_qsize(&packets, &accum_bytes);
+
+        // Every core sends 100 * run + pid + run
+        int correct = 0;
+        for (int i = 0; i < packets; i++) {
+            int tag, status, payload;
+            ebsp_get_tag(&status, &tag);
+            ebsp_move(&payload, sizeof(int));
+            if (payload == 100 * run + tag + run)
+                correct++;
+        }
+        printf("run %d: %d\n", run, correct == bsp_nprocs());
+    }
+
+    // A run without messages from the host
+    ebsp_spmd();
+    int packets, accum_bytes;
+    ebsp_qsize(&packets, &accum_bytes);
+    printf("run 4: %d\n", packets == bsp_nprocs());
+
+    bsp_end();
+
+    printf("Done\n");
+
+    // expect: (run 1: 1)
+    // expect: (run 2: 1)
+    // expect: (run 3: 1)
+    // expect: (run 4: 1)
+    // expect: (Done)
+    return 0;
+}
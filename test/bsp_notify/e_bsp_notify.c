@@ -0,0 +1,76 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+#define STEPS 10
+
+int inbox[STEPS];
+int received = 0;
+int gathered[16];
+int arrived = 0;
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+    int p = bsp_nprocs();
+
+    bsp_push_reg(&inbox, sizeof(inbox));
+    bsp_sync();
+    bsp_push_reg(&received, sizeof(int));
+    bsp_sync();
+    bsp_push_reg(&gathered, sizeof(gathered));
+    bsp_sync();
+    bsp_push_reg(&arrived, sizeof(int));
+    bsp_sync();
+
+    // Every core passes a value to the next core in every step, and waits
+    // for the value of the previous core, without any barrier
+    int correct = 0;
+    for (int step = 0; step < STEPS; ++step) {
+        int data = 100 * s + step;
+        ebsp_put_notify((s + 1) % p, &data, &inbox, step * sizeof(int),
+                        sizeof(int), &received);
+        ebsp_wait_notify(&received, 1);
+        correct += (inbox[step] == 100 * ((s + p - 1) % p) + step);
+    }
+
+    // test: all values arrived before their notification
+    EBSP_MSG_ORDERED("%i", correct);
+    // expect_for_pid: (10)
+
+    // test: core 0 waits for the notifications of all cores at once
+    ebsp_put_notify(0, &s, &gathered, s * sizeof(int), sizeof(int), &arrived);
+    if (s == 0) {
+        ebsp_wait_notify(&arrived, p);
+        int sum = 0;
+        for (int i = 0; i < p; ++i)
+            sum += gathered[i];
+        ebsp_message("%i %i", sum, arrived);
+    }
+    // expect: ($00: 120 0)
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+    int p = bsp_nprocs();
+
+    int a = 0;
+    int c[16] = {0};
+    bsp_push_reg(&a, sizeof(int));
+    bsp_sync();
+    bsp_push_reg(&c, sizeof(c));
+    bsp_sync();
+
+    // test: small puts from the local buffer
+    int data = s;
+    bsp_put((s + 1) % p, &data, &a, 0, sizeof(int));
+    for (int t = 0; t < p; ++t)
+        bsp_put(t, &data, &c, sizeof(int) * s, sizeof(int));
+    bsp_sync();
+
+    EBSP_MSG_ORDERED("%i", a);
+    // expect_for_pid: ((pid - 1) % 16)
+
+    EBSP_MSG_ORDERED("%i", c[5]);
+    // expect_for_pid: ("5")
+
+    // test: the buffer of 256 bytes is full after three of these puts,
+    // and the later puts to the same variable still win
+    for (int i = 0; i < 8; ++i) {
+        c[0] = i;
+        bsp_put((s + 1) % p, c, &c, 0, sizeof(c));
+    }
+    bsp_sync();
+
+    EBSP_MSG_ORDERED("%i", c[0]);
+    // expect_for_pid: ("7")
+
+    // test: the buffer is empty again after bsp_sync
+    data = 100 + s;
+    bsp_put((s + 1) % p, &data, &a, 0, sizeof(int));
+    bsp_sync();
+
+    EBSP_MSG_ORDERED("%i", a);
+    // expect_for_pid: (100 + (pid - 1) % 16)
+
+    bsp_end();
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+int syncs = 0;
+
+void sync_callback() { printf("sync %d\n", syncs++); }
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_spmd_poll.elf", argc, argv);
+    bsp_begin(bsp_nprocs());
+    ebsp_set_sync_callback(sync_callback);
+
+    if (!ebsp_spmd_start())
+        return 1;
+
+    // The host is free to do other work between two polls
+    int polls = 0;
+    while (ebsp_spmd_poll())
+        polls++;
+
+    printf("polled: %d\n", polls > 0);
+    printf("wait: %d\n", ebsp_spmd_wait());
+    printf("poll: %d\n", ebsp_spmd_poll());
+
+    bsp_end();
+
+    printf("Done\n");
+
+    // expect: ($00: step 0)
+    // expect: (sync 0)
+    // expect: ($00: step 1)
+    // expect: (sync 1)
+    // expect: ($00: step 2)
+    // expect: (sync 2)
+    // expect: (polled: 1)
+    // expect: (wait: 1)
+    // expect: (poll: 0)
+    // expect: (Done)
+    return 0;
+}
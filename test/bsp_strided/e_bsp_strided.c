@@ -0,0 +1,71 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <e_bsp.h>
+#include "../common.h"
+
+#define N 16
+
+int matrix[N][N];
+
+int main() {
+    bsp_begin();
+    int s = bsp_pid();
+    int p = bsp_nprocs();
+
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            matrix[i][j] = 1000 * s + N * i + j;
+    bsp_push_reg(&matrix, sizeof(matrix));
+    bsp_sync();
+
+    // Column 2 becomes row 5 on the next core. The blocks are small, so
+    // they are copied by the cpu
+    ebsp_put_strided((s + 1) % p, &matrix[0][2], &matrix,
+                     5 * N * sizeof(int), N, sizeof(int), N * sizeof(int),
+                     sizeof(int));
+
+    // Columns 0 and 1 of the previous core become columns 8 and 9. This is
+    // copied by a DMA task, before the put
+    ebsp_get_strided((s + p - 1) % p, &matrix, 0, &matrix[0][8], N,
+                     2 * sizeof(int), N * sizeof(int), N * sizeof(int));
+    bsp_sync();
+
+    // test: the column of the put is a row
+    EBSP_MSG_ORDERED("%i", matrix[5][7]);
+    // expect_for_pid: (1000 * ((pid - 1) % 16) + 16 * 7 + 2)
+
+    // test: the columns of the get
+    EBSP_MSG_ORDERED("%i", matrix[15][9]);
+    // expect_for_pid: (1000 * ((pid - 1) % 16) + 16 * 15 + 1)
+
+    EBSP_MSG_ORDERED("%i", matrix[0][8]);
+    // expect_for_pid: (1000 * ((pid - 1) % 16))
+
+    // test: data next to the blocks is not changed
+    EBSP_MSG_ORDERED("%i", matrix[15][10]);
+    // expect_for_pid: (1000 * pid + 16 * 15 + 10)
+
+    bsp_end();
+
+    return 0;
+}
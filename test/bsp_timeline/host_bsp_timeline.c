@@ -0,0 +1,86 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <host_bsp.h>
+#include <stdio.h>
+
+#define MAX_RECORDS 256
+
+int callbacks = 0;
+
+void sync_callback() { callbacks++; }
+
+int main(int argc, char** argv) {
+    bsp_init("e_bsp_timeline.elf", argc, argv);
+    bsp_begin(bsp_nprocs());
+
+    ebsp_set_sync_callback(sync_callback);
+    ebsp_timeline_enable(MAX_RECORDS);
+
+    ebsp_spmd();
+
+    ebsp_timeline_record records[MAX_RECORDS];
+    int count = ebsp_timeline_records(records, MAX_RECORDS);
+
+    int events[4] = {0, 0, 0, 0};
+    int ordered = 1;
+    for (int i = 0; i < count; i++) {
+        events[records[i].event]++;
+        if (i > 0 && records[i].time < records[i - 1].time)
+            ordered = 0;
+        // Every core syncs after the previous release
+        if (records[i].event == EBSP_TIMELINE_RELEASE &&
+            records[i].superstep != events[EBSP_TIMELINE_RELEASE] - 1)
+            ordered = 0;
+    }
+
+    printf("syncs: %d\n", events[EBSP_TIMELINE_SYNC] / bsp_nprocs());
+    printf("callbacks: %d %d\n", events[EBSP_TIMELINE_CALLBACK], callbacks);
+    printf("releases: %d\n", events[EBSP_TIMELINE_RELEASE]);
+    printf("finishes: %d\n", events[EBSP_TIMELINE_FINISH] / bsp_nprocs());
+    printf("ordered: %d\n", ordered);
+
+    // A small ring keeps only the last records
+    bsp_end();
+    bsp_init("e_bsp_timeline.elf", argc, argv);
+    bsp_begin(bsp_nprocs());
+    ebsp_timeline_enable(4);
+    ebsp_spmd();
+    count = ebsp_timeline_records(records, MAX_RECORDS);
+    printf("last: %d %d\n", count, records[count - 1].event);
+
+    printf("dump: %d %d\n", ebsp_timeline_dump("timeline.csv", EBSP_TIMELINE_CSV),
+           ebsp_timeline_dump("timeline.json", EBSP_TIMELINE_CHROME));
+    remove("timeline.csv");
+    remove("timeline.json");
+
+    bsp_end();
+
+    // expect: (syncs: 3)
+    // expect: (callbacks: 3 3)
+    // expect: (releases: 3)
+    // expect: (finishes: 1)
+    // expect: (ordered: 1)
+    // expect: (last: 4 3)
+    // expect: (dump: 1 1)
+    return 0;
+}
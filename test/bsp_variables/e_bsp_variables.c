@@ -82,6 +82,71 @@ int main() {
     EBSP_MSG_ORDERED("%i", data);
     // expect_for_pid: ("4")
 
+    // test: the host raised the limit on registered variables
+    int many[32] = {0};
+    for (int i = 0; i < 32; ++i)
+        bsp_push_reg(&many[i], sizeof(int));
+    bsp_sync();
+
+    for (int i = 0; i < 32; ++i)
+        bsp_put((s + 1) % p, &i, &many[i], 0, sizeof(int));
+    bsp_sync();
+
+    int sum = 0;
+    for (int i = 0; i < 32; ++i)
+        sum += many[i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: ("496")
+
+    // test: more gets from one core than it can write to this core
+    int got[32] = {0};
+    for (int i = 0; i < 32; ++i)
+        bsp_get((s + 1) % p, &many[i], 0, &got[i], sizeof(int));
+    bsp_sync();
+
+    sum = 0;
+    for (int i = 0; i < 32; ++i)
+        sum += got[i];
+    EBSP_MSG_ORDERED("%i", sum);
+    // expect_for_pid: ("496")
+
+    for (int i = 0; i < 32; ++i)
+        bsp_pop_reg(&many[i]);
+    bsp_sync();
+
+    // test: large requests, where the get still reads the data from
+    // before the put that overwrites it
+    int big[256];
+    int big_old[256];
+    int big_new[256];
+    for (int i = 0; i < 256; ++i) {
+        big[i] = s;
+        big_new[i] = 100 + s;
+    }
+    bsp_push_reg(big, sizeof(big));
+    bsp_sync();
+
+    bsp_get((s + 1) % p, big, 0, big_old, sizeof(big));
+    bsp_put((s + 1) % p, big_new, big, 0, sizeof(big));
+    bsp_sync();
+
+    EBSP_MSG_ORDERED("%i", big_old[0] + big_old[255]);
+    // expect_for_pid: (2 * ((pid + 1) % 16))
+
+    EBSP_MSG_ORDERED("%i", big[0] + big[255]);
+    // expect_for_pid: (2 * (100 + (pid - 1) % 16))
+
+    // test: more payload than fits in one chunk, so that the cores take
+    // new chunks of the buffer at the same time
+    for (int i = 0; i < 24; ++i) {
+        big_new[0] = i;
+        bsp_put((s + 1) % p, big_new, big, 0, sizeof(big));
+    }
+    bsp_sync();
+
+    EBSP_MSG_ORDERED("%i", big[0]);
+    // expect_for_pid: ("23")
+
     bsp_end();
 
     return 0;
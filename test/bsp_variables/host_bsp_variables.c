@@ -25,6 +25,8 @@ see the files COPYING and COPYING.LESSER. If not, see
 int main(int argc, char** argv) {
     bsp_init("e_bsp_variables.elf", argc, argv);
     bsp_begin(bsp_nprocs());
+    ebsp_set_max_bsp_vars(40);
+    ebsp_set_get_inbox_size(4);
     ebsp_spmd();
     bsp_end();
 
@@ -34,9 +34,9 @@ int main() {
 
     // test: can obtain messages from host
     EBSP_MSG_ORDERED("packets: %i", packets);
-    // expect_for_pid: ("packets: 2")
+    // expect_for_pid: ("packets: 3")
 
-    int payload_in[2] = {0};
+    int payload_in[3] = {0};
     int payload_size = 0;
     int tag_in = 0;
     for (int i = 0; i < packets; ++i) {
@@ -52,6 +52,10 @@ int main() {
     EBSP_MSG_ORDERED("%i", payload_in[1]);
     // expect_for_pid: (1234)
 
+    // test: can obtain a large message from host
+    EBSP_MSG_ORDERED("%i", payload_in[2]);
+    // expect_for_pid: (5000 + pid)
+
     // test: gets the correct size from host
     EBSP_MSG_ORDERED("%i", payload_size);
     // expect_for_pid: (4)
@@ -34,9 +34,17 @@ int main(int argc, char** argv) {
     int tagsize = sizeof(int);
     ebsp_set_tagsize(&tagsize);
 
+    // More than half of the payload buffer in total
+    int big_size = 0x50000 / n;
+    int* big = malloc(big_size);
+
     int tag = 0;
     int payload = 0;
     for (int s = 0; s < n; ++s) {
+        tag = 2;
+        big[0] = 5000 + s;
+        ebsp_send_down(s, &tag, big, big_size);
+
         tag = 0;
         payload = 1000 + s;
         ebsp_send_down(s, &tag, &payload, sizeof(int));
@@ -75,6 +83,7 @@ int main(int argc, char** argv) {
     }
 
     free(payloads);
+    free(big);
 
     bsp_end();
 
@@ -0,0 +1,41 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// The bitmask allocator that is used by default
+
+#define MALLOC_FUNCTION_PREFIX
+#define _malloc bitmap_malloc
+#define _malloc_in bitmap_malloc_in
+#define _free bitmap_free
+#define _init_malloc_state bitmap_init_malloc_state
+#define _get_malloc_info bitmap_get_malloc_info
+#define _get_largest_free_run bitmap_get_largest_free_run
+#define _check_heap bitmap_check_heap
+#define _first_fit bitmap_first_fit
+#include "extmem_malloc_implementation.cpp"
+#include "reference.cpp"
+#include "common.h"
+
+allocator bitmap_allocator = {
+    "bitmap", 0, bitmap_malloc, bitmap_malloc_in, bitmap_free,
+    bitmap_init_malloc_state, bitmap_get_malloc_info,
+    bitmap_get_largest_free_run, bitmap_check_heap, bitmap_first_fit};
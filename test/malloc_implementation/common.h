@@ -0,0 +1,48 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+// The allocators of src/extmem_malloc_implementation.cpp, compiled with and
+// without MALLOC_SIZE_CLASSES, together with a check of their state against
+// a plain scan of the bitmask, see reference.cpp
+typedef struct {
+    const char* name;
+    // Requests of at most this many bytes use the free lists
+    uint32_t small_max;
+    void* (*malloc)(void* base, uint32_t nbytes);
+    void* (*malloc_in)(void* base, uint32_t nbytes, uint32_t first,
+                       uint32_t last);
+    void (*free)(void* base, void* ptr);
+    void (*init)(void* base, uint32_t size);
+    void (*info)(void* base, uint32_t* used, uint32_t* free,
+                 uint32_t* free_list);
+    uint32_t (*largest_free_run)(void* base);
+    // Returns the number of inconsistencies in the heap
+    int (*check)(void* base);
+    // The block that a first fit in the bitmask would return, or 0
+    void* (*first_fit)(void* base, uint32_t nbytes, uint32_t first,
+                       uint32_t last);
+} allocator;
+
+extern allocator bitmap_allocator;
+extern allocator size_class_allocator;
@@ -0,0 +1,126 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Runs the allocator of ebsp_ext_malloc and ebsp_malloc on the host, with
+// and without MALLOC_SIZE_CLASSES, and compares its summary counts, free
+// run hint, statistics and the blocks of _malloc_in with a plain scan of
+// the bitmask after random allocations and frees, some of which are
+// pointers into a block
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "common.h"
+
+#define HEAP_SIZE (1 << 20)
+#define SLOTS 1024
+#define OPERATIONS 40000
+#define CHECK_INTERVAL 64
+
+uint32_t random_state = 1;
+
+uint32_t next_random() {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+// Mostly small blocks for the free lists, and some large ones
+uint32_t random_size() {
+    uint32_t r = next_random() % 10;
+    if (r < 6)
+        return next_random() % 121;
+    if (r < 9)
+        return 128 + next_random() % 1920;
+    return 4096 + next_random() % 28672;
+}
+
+int run(allocator* a, void* heap) {
+    void* slots[SLOTS] = {0};
+    int errors = 0;
+
+    a->init(heap, HEAP_SIZE);
+    uint32_t used, free, free_list;
+    a->info(heap, &used, &free, &free_list);
+    uint32_t chunks = free / 8;
+    random_state = 1;
+
+    for (int i = 0; i < OPERATIONS; i++) {
+        int k = next_random() % SLOTS;
+        if (slots[k] && next_random() % 8 == 0) {
+            // A pointer after the first word of a block, like the data of
+            // a stream buffer, is not freed
+            a->free(heap, slots[k] + sizeof(int));
+        } else if (slots[k]) {
+            a->free(heap, slots[k]);
+            slots[k] = 0;
+        } else {
+            uint32_t nbytes = random_size();
+            void* expected;
+            if (next_random() % 4 == 0) {
+                // A random range, as for ebsp_malloc_bank
+                uint32_t first = next_random() % chunks;
+                uint32_t last = first + 1 + next_random() % (chunks - first);
+                expected = a->first_fit(heap, nbytes, first, last);
+                slots[k] = a->malloc_in(heap, nbytes, first, last);
+            } else {
+                expected = a->first_fit(heap, nbytes, 0, chunks);
+                slots[k] = a->malloc(heap, nbytes);
+                if (nbytes <= a->small_max)
+                    expected = slots[k];
+            }
+            if (slots[k] != expected) {
+                printf("%s: allocation %d of %u bytes at %p instead of %p\n",
+                       a->name, i, nbytes, slots[k], expected);
+                errors++;
+            }
+        }
+        if (i % CHECK_INTERVAL == 0)
+            errors += a->check(heap);
+    }
+
+    for (int k = 0; k < SLOTS; k++)
+        if (slots[k])
+            a->free(heap, slots[k]);
+    errors += a->check(heap);
+    printf("%s: %d errors\n", a->name, errors);
+
+    // Everything is free again, also the memory of the free lists
+    a->info(heap, &used, &free, &free_list);
+    if (used == 0 && free_list == 0 && a->largest_free_run(heap) == free)
+        printf("%s: empty heap is one free run\n", a->name);
+    else
+        printf("%s: %u used, %u free, %u in free lists, largest run %u\n",
+               a->name, used, free, free_list, a->largest_free_run(heap));
+    return errors;
+}
+
+int main() {
+    void* heap = malloc(HEAP_SIZE);
+    run(&bitmap_allocator, heap);
+    run(&size_class_allocator, heap);
+    free(heap);
+
+    // expect: (bitmap: 0 errors)
+    // expect: (bitmap: empty heap is one free run)
+    // expect: (size classes: 0 errors)
+    // expect: (size classes: empty heap is one free run)
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+This file is part of the Epiphany BSP library.
+
+Copyright (C) 2014-2015 Buurlage Wits
+Support e-mail: <info@buurlagewits.nl>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License (LGPL)
+as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+and the GNU Lesser General Public License along with this program,
+see the files COPYING and COPYING.LESSER. If not, see
+<http://www.gnu.org/licenses/>.
+*/
+
+// Checks of the state of the allocator, by scanning the bitmask one bit at
+// a time. This is included after extmem_malloc_implementation.cpp, with
+// _check_heap and _first_fit renamed like the functions of the allocator
+
+#include <stdio.h>
+
+inline int chunk_in_use(const void* base, uint32_t chunk) {
+    return (get_bitmasks(base)[chunk / 32] >> (chunk % 32)) & 1;
+}
+
+// Length of the longest run of free chunks
+static uint32_t reference_longest_run(const void* base) {
+    uint32_t longest_run = 0;
+    uint32_t run = 0;
+    for (uint32_t c = 0; c < 32 * get_bitmask_count(base); c++) {
+        if (chunk_in_use(base, c)) {
+            run = 0;
+        } else if (++run > longest_run) {
+            longest_run = run;
+        }
+    }
+    return longest_run;
+}
+
+int _check_heap(void* base) {
+    int errors = 0;
+    uint32_t total_bitmask_ints = get_bitmask_count(base);
+    uint32_t* summary = get_summary(base);
+
+    // Every summary int counts the chunks in use in 32 bitmask ints
+    uint32_t bits_in_use = 0;
+    for (uint32_t i = 0; i < compute_total_summary_ints(total_bitmask_ints);
+         i++) {
+        uint32_t used = 0;
+        for (uint32_t c = 32 * 32 * i;
+             c < 32 * 32 * (i + 1) && c < 32 * total_bitmask_ints; c++)
+            used += chunk_in_use(base, c);
+        if (summary[i] != used) {
+            printf("summary %u is %u instead of %u\n", i, summary[i], used);
+            errors++;
+        }
+        bits_in_use += used;
+    }
+
+    // The hint may be too large, but never too small
+    uint32_t longest_run = reference_longest_run(base);
+    if (*get_free_run_hint(base) < longest_run) {
+        printf("free run hint is %u, but there is a run of %u chunks\n",
+               *get_free_run_hint(base), longest_run);
+        errors++;
+    }
+    if (_get_largest_free_run(base) != longest_run * CHUNK_SIZE) {
+        printf("largest free run is %u instead of %u\n",
+               _get_largest_free_run(base), longest_run * CHUNK_SIZE);
+        errors++;
+    }
+
+    uint32_t free_list_bytes = 0;
+#ifdef MALLOC_SIZE_CLASSES
+    // The blocks of the free lists are linked in both directions, are in
+    // use in the bitmask and belong to a slab with allocated blocks
+    uint32_t* free_lists = get_free_lists(base);
+    for (uint32_t i = 0; i < SMALL_CHUNKS_MAX; i++) {
+        uint32_t prev = 0;
+        for (uint32_t offset = free_lists[i]; offset != 0;) {
+            free_block* block = (free_block*)(base + offset);
+            uint32_t chunk =
+                (uint32_t)((void*)block - get_alloc_base(base)) / CHUNK_SIZE;
+            memory_object* slab = (memory_object*)(base + block->slab);
+            if (block->header.chunk_count != i + 1 ||
+                block->prev_free != prev || !chunk_in_use(base, chunk) ||
+                slab->next_free == 0) {
+                printf("free list %u is corrupt at offset %u\n", i, offset);
+                errors++;
+                break;
+            }
+            free_list_bytes += block->header.chunk_count * CHUNK_SIZE;
+            prev = offset;
+            offset = block->header.next_free;
+        }
+    }
+#endif
+
+    uint32_t used, free, free_list;
+    _get_malloc_info(base, &used, &free, &free_list);
+    if (free_list != free_list_bytes ||
+        used + free_list != bits_in_use * CHUNK_SIZE ||
+        free != (32 * total_bitmask_ints - bits_in_use) * CHUNK_SIZE) {
+        printf("malloc info is %u used, %u free, %u in free lists\n", used,
+               free, free_list);
+        errors++;
+    }
+    return errors;
+}
+
+void* _first_fit(void* base, uint32_t nbytes, uint32_t first, uint32_t last) {
+    uint32_t chunk_count = chunk_division(nbytes + sizeof(memory_object));
+    uint32_t run = 0;
+    for (uint32_t c = first; c < last; c++) {
+        if (chunk_in_use(base, c)) {
+            run = 0;
+        } else if (++run == chunk_count) {
+            return get_alloc_base(base) +
+                   CHUNK_SIZE * (c + 1 - chunk_count) + sizeof(memory_object);
+        }
+    }
+    return 0;
+}